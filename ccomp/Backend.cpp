@@ -0,0 +1,372 @@
+#include "Backend.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/DiagnosticPrinter.h"
+#include "llvm/IR/LLVMRemarkStreamer.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/PassInstrumentation.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Remarks/RemarkStreamer.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/Regex.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/IPO/GlobalDCE.h"
+#include "llvm/Transforms/IPO/HotColdSplitting.h"
+#include "llvm/Transforms/IPO/Internalize.h"
+#include "llvm/Transforms/Utils/SplitModule.h"
+
+static std::once_flag NativeTargetInitFlag;
+
+Backend::Backend(unsigned OptLevel) : OptLevel(OptLevel), Error(false) {
+    // Target registration is global, compilations running on other threads share it
+    std::call_once(NativeTargetInitFlag, [] {
+        InitializeNativeTarget();
+        InitializeNativeTargetAsmPrinter();
+    });
+
+    TargetTriple = sys::getDefaultTargetTriple();
+}
+
+bool Backend::GetError(std::string &Msg) {
+    std::lock_guard<std::mutex> Lock(ErrorMutex);
+    if (Error)
+        Msg = ErrorTextMsg;
+    return Error;
+}
+
+std::string Backend::GetRemarks() {
+    std::lock_guard<std::mutex> Lock(RemarksMutex);
+    return RemarksText;
+}
+
+std::vector<std::pair<std::string, uint64_t>> Backend::GetFunctionCounts() {
+    std::lock_guard<std::mutex> Lock(CountsMutex);
+    return FunctionCounts;
+}
+
+void Backend::AddRemark(const std::string &Text) {
+    std::lock_guard<std::mutex> Lock(RemarksMutex);
+    RemarksText += Text;
+}
+
+// Formats the remarks of the passes matching the patterns of a backend like
+// a compiler diagnostic, every other diagnostic keeps the default handling
+class RemarkHandler : public DiagnosticHandler {
+public:
+    explicit RemarkHandler(Backend *Owner) : Owner(Owner), Passed(Owner->RemarksPassed),
+                                             Missed(Owner->RemarksMissed), Analysis(Owner->RemarksAnalysis) {}
+
+    bool isPassedOptRemarkEnabled(StringRef PassName) const override {
+        return !Owner->RemarksPassed.empty() && Passed.match(PassName);
+    }
+
+    bool isMissedOptRemarkEnabled(StringRef PassName) const override {
+        return !Owner->RemarksMissed.empty() && Missed.match(PassName);
+    }
+
+    bool isAnalysisRemarkEnabled(StringRef PassName) const override {
+        return !Owner->RemarksAnalysis.empty() && Analysis.match(PassName);
+    }
+
+    bool isAnyRemarkEnabled() const override {
+        return !Owner->RemarksPassed.empty() || !Owner->RemarksMissed.empty() || !Owner->RemarksAnalysis.empty();
+    }
+
+    bool handleDiagnostics(const DiagnosticInfo &DI) override {
+        // Failed transformations requested by loop metadata are warnings
+        auto Remark = dyn_cast<DiagnosticInfoOptimizationBase>(&DI);
+        if (!Remark || Remark->getSeverity() != DS_Remark || !Remark->isEnabled())
+            return false;
+
+        auto Option = Remark->isPassed() ? "-Rpass" : Remark->isMissed() ? "-Rpass-missed" : "-Rpass-analysis";
+        Owner->AddRemark(Remark->getLocationStr() + ": remark: " + Remark->getMsg() + " [" + Option + "="
+                         + Remark->getPassName().str() + "]\n");
+        return true;
+    }
+
+private:
+    Backend *Owner;
+    // Matching does not change a regex, handlers of concurrent workers own theirs anyway
+    Regex Passed;
+    Regex Missed;
+    Regex Analysis;
+};
+
+// Turns the errors of linking into backend errors, the default handler exits
+class LinkErrorHandler : public DiagnosticHandler {
+public:
+    explicit LinkErrorHandler(Backend *Owner) : Owner(Owner) {}
+
+    bool handleDiagnostics(const DiagnosticInfo &DI) override {
+        if (DI.getSeverity() != DS_Error)
+            return false;
+
+        std::string Msg;
+        raw_string_ostream OS(Msg);
+        DiagnosticPrinterRawOStream Printer(OS);
+        DI.print(Printer);
+        Owner->ThrowError(OS.str());
+        return true;
+    }
+
+private:
+    Backend *Owner;
+};
+
+void Backend::SetupRemarks(LLVMContext &Context) {
+    if (!RemarksPassed.empty() || !RemarksMissed.empty() || !RemarksAnalysis.empty())
+        Context.setDiagnosticHandler(std::make_unique<RemarkHandler>(this));
+}
+
+void Backend::FinishRemarks(LLVMContext &Context) {
+    Context.setLLVMRemarkStreamer(nullptr);
+    Context.setMainRemarkStreamer(nullptr);
+    Context.setDiagnosticHandler(std::make_unique<DiagnosticHandler>());
+}
+
+void Backend::ThrowError(const std::string &Msg) {
+    std::lock_guard<std::mutex> Lock(ErrorMutex);
+    // Workers may fail concurrently, keep the first message
+    if (!Error)
+        ErrorTextMsg = Msg;
+    Error = true;
+}
+
+std::unique_ptr<TargetMachine> Backend::CreateTargetMachine() {
+    std::string LookupError;
+    auto Target = TargetRegistry::lookupTarget(TargetTriple, LookupError);
+    if (!Target) {
+        ThrowError(LookupError);
+        return nullptr;
+    }
+
+    CodeGenOpt::Level Level;
+    switch (OptLevel) {
+        case 0:
+            Level = CodeGenOpt::None;
+            break;
+        case 1:
+            Level = CodeGenOpt::Less;
+            break;
+        case 2:
+            Level = CodeGenOpt::Default;
+            break;
+        default:
+            Level = CodeGenOpt::Aggressive;
+            break;
+    }
+
+    TargetOptions Options;
+    Options.FunctionSections = FunctionSections;
+    return std::unique_ptr<TargetMachine>(
+            Target->createTargetMachine(TargetTriple, "generic", "", Options, Reloc::PIC_, {}, Level));
+}
+
+void Backend::Optimize(Module &M, TargetMachine *TM) {
+    LoopAnalysisManager LAM;
+    FunctionAnalysisManager FAM;
+    CGSCCAnalysisManager CGAM;
+    ModuleAnalysisManager MAM;
+
+    PassInstrumentationCallbacks PIC;
+#if LLVM_VERSION_MAJOR < 15
+    // LoopAccessAnalysis of LLVM 14 asks opaque pointers for their element
+    // type and crashes, so the passes built on it are skipped there
+    PIC.registerShouldRunOptionalPassCallback([](StringRef Name, Any) {
+        return Name != "LoopVectorizePass" && Name != "LoopLoadEliminationPass" && Name != "LoopDistributePass";
+    });
+#endif
+
+    Optional<PGOOptions> PGOOpt;
+    if (ProfileGenerate)
+        PGOOpt = PGOOptions("", "", "", PGOOptions::IRInstr);
+    else if (!ProfileUse.empty())
+        PGOOpt = PGOOptions(ProfileUse, "", "", PGOOptions::IRUse);
+
+    PassBuilder PB(TM, PipelineTuningOptions(), PGOOpt, &PIC);
+    PB.registerModuleAnalyses(MAM);
+    PB.registerCGSCCAnalyses(CGAM);
+    PB.registerFunctionAnalyses(FAM);
+    PB.registerLoopAnalyses(LAM);
+    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+    // Splitting runs last, when inlining has placed the cold blocks in their callers
+    if (SplitColdCode)
+        PB.registerOptimizerLastEPCallback([](ModulePassManager &MPM, OptimizationLevel) {
+            MPM.addPass(HotColdSplittingPass());
+        });
+
+    ModulePassManager MPM;
+    switch (OptLevel) {
+        case 0:
+            MPM = PB.buildO0DefaultPipeline(OptimizationLevel::O0);
+            break;
+        case 1:
+            MPM = PB.buildPerModuleDefaultPipeline(OptimizationLevel::O1);
+            break;
+        case 2:
+            MPM = PB.buildPerModuleDefaultPipeline(OptimizationLevel::O2);
+            break;
+        default:
+            MPM = PB.buildPerModuleDefaultPipeline(OptimizationLevel::O3);
+            break;
+    }
+    MPM.run(M, MAM);
+
+    std::lock_guard<std::mutex> Lock(CountsMutex);
+    for (auto &Func: M) {
+        auto Count = Func.getEntryCount();
+        if (!Func.isDeclaration() && Count && Count->getCount())
+            FunctionCounts.emplace_back(Func.getName().str(), Count->getCount());
+    }
+}
+
+bool Backend::Prepare(Module &M, TargetMachine *TM) {
+    M.setTargetTriple(TargetTriple);
+    M.setDataLayout(TM->createDataLayout());
+
+    std::string VerifyMsg;
+    raw_string_ostream VerifyOS(VerifyMsg);
+    if (verifyModule(M, &VerifyOS)) {
+        ThrowError("invalid module `" + M.getModuleIdentifier() + "`: " + VerifyOS.str());
+        return false;
+    }
+
+    Optimize(M, TM);
+    return true;
+}
+
+bool Backend::Codegen(Module &M, TargetMachine *TM, const std::string &Path) {
+    std::error_code EC;
+    raw_fd_ostream Out(Path, EC, sys::fs::OF_None);
+    if (EC) {
+        ThrowError("cannot open `" + Path + "`: " + EC.message());
+        return false;
+    }
+
+    legacy::PassManager CodegenPM;
+    if (TM->addPassesToEmitFile(CodegenPM, Out, nullptr, CGFT_ObjectFile)) {
+        ThrowError("target cannot emit object files");
+        return false;
+    }
+    CodegenPM.run(M);
+    Out.flush();
+    return true;
+}
+
+std::unique_ptr<Module> Backend::LinkProgram(std::vector<std::unique_ptr<Module>> Modules,
+                                             const std::set<std::string> &Exported) {
+    auto Program = std::move(Modules[0]);
+    auto &Context = Program->getContext();
+    Context.setDiagnosticHandler(std::make_unique<LinkErrorHandler>(this));
+    bool Failed = false;
+    for (size_t i = 1; i < Modules.size() && !Failed; i++)
+        Failed = Linker::linkModules(*Program, std::move(Modules[i]));
+    Context.setDiagnosticHandler(std::make_unique<DiagnosticHandler>());
+    if (Failed)
+        return nullptr;
+
+    internalizeModule(*Program, [&](const GlobalValue &Value) {
+        return Value.getName() == "main" || Exported.count(Value.getName().str());
+    });
+
+    // Functions no one calls anymore go now, before they cost any optimization
+    // time. Even -O0 drops them; -O1 and above also propagate constants across
+    // calls and inline through the file boundaries.
+    ModuleAnalysisManager MAM;
+    PassBuilder PB;
+    PB.registerModuleAnalyses(MAM);
+    GlobalDCEPass().run(*Program, MAM);
+    return Program;
+}
+
+bool Backend::EmitObject(Module &M, const std::string &Path) {
+    auto TM = CreateTargetMachine();
+    if (!TM)
+        return false;
+
+    auto &Context = M.getContext();
+    SetupRemarks(Context);
+    std::unique_ptr<ToolOutputFile> Record;
+    if (!RemarksFile.empty()) {
+        auto File = setupLLVMOptimizationRemarks(Context, RemarksFile, "", "yaml", false);
+        if (!File) {
+            ThrowError("cannot record remarks to `" + RemarksFile + "`: " + toString(File.takeError()));
+            return false;
+        }
+        Record = std::move(*File);
+    }
+
+    bool Emitted = Prepare(M, TM.get()) && Codegen(M, TM.get(), Path);
+    FinishRemarks(Context);
+    if (Record && Emitted)
+        Record->keep();
+    return Emitted;
+}
+
+bool Backend::EmitObjects(Module &M, unsigned CodegenUnits, unsigned Threads, const std::string &Prefix,
+                          std::vector<std::string> &Paths) {
+    // The whole module is optimized first, so inlining and the other
+    // interprocedural passes see every function; only codegen is split
+    auto TM = CreateTargetMachine();
+    if (!TM)
+        return false;
+    SetupRemarks(M.getContext());
+    bool Prepared = Prepare(M, TM.get());
+    FinishRemarks(M.getContext());
+    if (!Prepared)
+        return false;
+
+    unsigned Definitions = 0;
+    for (auto &Func: M)
+        if (!Func.isDeclaration())
+            Definitions++;
+    unsigned Units = std::max(1u, std::min(CodegenUnits, Definitions));
+
+    // Partitions travel as bitcode, so every worker owns a private LLVMContext
+    std::vector<SmallString<0>> Partitions;
+    SplitModule(M, Units, [&](std::unique_ptr<Module> Part) {
+        SmallString<0> Buffer;
+        raw_svector_ostream OS(Buffer);
+        WriteBitcodeToFile(*Part, OS);
+        Partitions.push_back(std::move(Buffer));
+    }, true);
+
+    Paths.clear();
+    for (size_t i = 0; i < Partitions.size(); i++)
+        Paths.push_back(Prefix + "." + std::to_string(i) + ".o");
+
+    ThreadPool Pool(heavyweight_hardware_concurrency(Threads));
+    for (size_t i = 0; i < Partitions.size(); i++) {
+        Pool.async([this, &Partitions, &Paths, i] {
+            LLVMContext Context;
+#if LLVM_VERSION_MAJOR < 15
+            Context.enableOpaquePointers();
+#endif
+            SetupRemarks(Context);
+            MemoryBufferRef Buffer(StringRef(Partitions[i].data(), Partitions[i].size()), Paths[i]);
+            auto PartModule = parseBitcodeFile(Buffer, Context);
+            if (!PartModule) {
+                ThrowError(toString(PartModule.takeError()));
+                return;
+            }
+            // Target machines are not thread safe, each worker creates its own
+            auto PartTM = CreateTargetMachine();
+            if (PartTM)
+                Codegen(**PartModule, PartTM.get(), Paths[i]);
+        });
+    }
+    Pool.wait();
+
+    return !Error;
+}
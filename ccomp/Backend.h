@@ -0,0 +1,101 @@
+#ifndef BACKEND_H
+#define BACKEND_H
+
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "llvm/IR/Module.h"
+#include "llvm/Target/TargetMachine.h"
+
+using namespace llvm;
+
+class Backend {
+public:
+    explicit Backend(unsigned OptLevel);
+
+    unsigned OptLevel;
+    std::string TargetTriple;
+
+    // Patterns of the pass names whose passed, missed and analysis remarks are
+    // reported, as -Rpass=, -Rpass-missed= and -Rpass-analysis= do
+    std::string RemarksPassed;
+    std::string RemarksMissed;
+    std::string RemarksAnalysis;
+    // YAML file EmitObject records every remark to, none when empty
+    std::string RemarksFile;
+
+    // Instruments the optimized code to count blocks and calls into a .profraw
+    // file, which the program must be linked with the profile runtime for
+    bool ProfileGenerate = false;
+    // Indexed profile whose counts annotate the branches and functions before
+    // they are optimized, none when empty
+    std::string ProfileUse;
+    // Puts every function into a section of its own, which lets the linker
+    // order them and group the hot and cold ones by their section prefix
+    bool FunctionSections = false;
+    // Outlines the blocks the profile found cold into functions of their own
+    bool SplitColdCode = false;
+
+    bool GetError(std::string &Msg);
+
+    // Remarks reported so far, one per line with the source location first
+    std::string GetRemarks();
+
+    // Profile entry counts of the functions optimized so far that were run
+    std::vector<std::pair<std::string, uint64_t>> GetFunctionCounts();
+
+    // Links Modules into the first one and internalizes every symbol but main
+    // and Exported, so the optimizer sees the whole program and may drop,
+    // specialize and inline any other function. Returns nullptr on errors.
+    std::unique_ptr<Module> LinkProgram(std::vector<std::unique_ptr<Module>> Modules,
+                                        const std::set<std::string> &Exported);
+
+    // Optimizes M in place and lowers it to an object file at Path.
+    bool EmitObject(Module &M, const std::string &Path);
+
+    // Optimizes M as a whole, then splits it into at most CodegenUnits
+    // partitions, clones each into its own LLVMContext and lowers them to
+    // Prefix.<index>.o on Threads workers. Partitioning only depends on M and
+    // CodegenUnits, so the objects are the same for any Threads.
+    bool EmitObjects(Module &M, unsigned CodegenUnits, unsigned Threads, const std::string &Prefix,
+                     std::vector<std::string> &Paths);
+
+private:
+    std::mutex ErrorMutex;
+    std::string ErrorTextMsg;
+    bool Error;
+
+    std::mutex RemarksMutex;
+    std::string RemarksText;
+
+    std::mutex CountsMutex;
+    std::vector<std::pair<std::string, uint64_t>> FunctionCounts;
+
+    std::unique_ptr<TargetMachine> CreateTargetMachine();
+
+    void Optimize(Module &M, TargetMachine *TM);
+
+    // Verifies M and optimizes it for the target of TM
+    bool Prepare(Module &M, TargetMachine *TM);
+
+    // Lowers an optimized module to an object file at Path
+    bool Codegen(Module &M, TargetMachine *TM, const std::string &Path);
+
+    // Reports the remarks enabled by the patterns that are raised in Context
+    void SetupRemarks(LLVMContext &Context);
+
+    // Detaches the remark handler and record file from a context that outlives the backend
+    void FinishRemarks(LLVMContext &Context);
+
+    void AddRemark(const std::string &Text);
+
+    void ThrowError(const std::string &Msg);
+
+    friend class RemarkHandler;
+    friend class LinkErrorHandler;
+};
+
+#endif
@@ -0,0 +1,178 @@
+#include "Cache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
+
+#ifndef CCOMP_VERSION
+#define CCOMP_VERSION "unknown"
+#endif
+
+// Temporary files older than this belong to a compiler that died mid-store
+static const auto StaleTempAge = std::chrono::hours(1);
+
+static void CacheAnchor() {}
+
+// Identifies the running compiler build, so a rebuilt ccomp never reuses objects
+// produced by an older one.
+static std::string GetCompilerStamp() {
+    std::string Stamp = CCOMP_VERSION;
+    auto ExePath = sys::fs::getMainExecutable(nullptr, (void *) &CacheAnchor);
+    sys::fs::file_status Status;
+    if (!ExePath.empty() && !sys::fs::status(ExePath, Status))
+        Stamp += " " + std::to_string(Status.getSize()) + " "
+                 + std::to_string(Status.getLastModificationTime().time_since_epoch().count());
+    return Stamp;
+}
+
+CompileCache::CompileCache(std::string Dir, uint64_t MaxBytes) : Dir(std::move(Dir)), MaxBytes(MaxBytes), Hits(0),
+                                                                  Misses(0) {}
+
+bool CompileCache::Init(std::string &Msg) {
+    if (auto EC = sys::fs::create_directories(Dir)) {
+        Msg = "cannot create cache directory `" + Dir + "`: " + EC.message();
+        return false;
+    }
+    return true;
+}
+
+std::string CompileCache::ComputeKey(StringRef Source, const std::vector<std::string> &Options) const {
+    static const std::string CompilerStamp = GetCompilerStamp();
+
+    std::string Data = "ccomp-cache-v1";
+    Data += '\0';
+    Data += CompilerStamp;
+    for (const auto &Option: Options) {
+        Data += '\0';
+        Data += Option;
+    }
+    Data += '\0';
+    Data += Source.str();
+
+    auto Digest = SHA1::hash(ArrayRef<uint8_t>((const uint8_t *) Data.data(), Data.size()));
+    return toHex(Digest, true);
+}
+
+std::string CompileCache::EntryPath(const std::string &Key) const {
+    return Dir + "/" + Key + ".o";
+}
+
+bool CompileCache::Lookup(const std::string &Key, const std::string &ObjectPath) {
+    auto Entry = EntryPath(Key);
+
+    // A concurrent prune may remove the entry at any point, which is just a miss
+    if (sys::fs::copy_file(Entry, ObjectPath)) {
+        Misses++;
+        return false;
+    }
+
+    int FD;
+    if (!sys::fs::openFileForWrite(Entry, FD, sys::fs::CD_OpenExisting, sys::fs::OF_Append)) {
+        sys::fs::setLastAccessAndModificationTime(FD, std::chrono::system_clock::now());
+        sys::fs::closeFile(FD);
+    }
+
+    Hits++;
+    return true;
+}
+
+void CompileCache::Store(const std::string &Key, const std::string &ObjectPath) {
+    SmallString<128> TempPath;
+    int FD;
+    if (sys::fs::createUniqueFile(Dir + "/tmp-%%%%%%%%.o", FD, TempPath))
+        return;
+    sys::fs::closeFile(FD);
+
+    if (sys::fs::copy_file(ObjectPath, TempPath) || sys::fs::rename(TempPath, EntryPath(Key)))
+        sys::fs::remove(TempPath);
+}
+
+void CompileCache::Prune() {
+    struct CacheEntry {
+        std::string Path;
+        uint64_t Size;
+        sys::TimePoint<> LastUsed;
+    };
+
+    std::vector<CacheEntry> Entries;
+    uint64_t TotalSize = 0;
+    auto Now = std::chrono::system_clock::now();
+
+    std::error_code EC;
+    for (sys::fs::directory_iterator It(Dir, EC), End; It != End && !EC; It.increment(EC)) {
+        auto Name = sys::path::filename(It->path());
+        if (!Name.endswith(".o"))
+            continue;
+
+        sys::fs::file_status Status;
+        if (sys::fs::status(It->path(), Status))
+            continue;
+
+        if (Name.startswith("tmp-")) {
+            if (Now - Status.getLastModificationTime() > StaleTempAge)
+                sys::fs::remove(It->path());
+            continue;
+        }
+
+        Entries.push_back({It->path(), Status.getSize(), Status.getLastModificationTime()});
+        TotalSize += Status.getSize();
+    }
+
+    if (TotalSize <= MaxBytes)
+        return;
+
+    std::sort(Entries.begin(), Entries.end(), [](const CacheEntry &A, const CacheEntry &B) {
+        return A.LastUsed < B.LastUsed;
+    });
+
+    for (const auto &Entry: Entries) {
+        if (TotalSize <= MaxBytes)
+            break;
+        if (!sys::fs::remove(Entry.Path))
+            TotalSize -= Entry.Size;
+    }
+}
+
+void CompileCache::ReportStats(std::ostream &OS) {
+    unsigned long long TotalHits = Hits;
+    unsigned long long TotalMisses = Misses;
+
+    // Other compilers update the same counters, so the read-modify-write is done under a lock
+    int FD;
+    auto StatsPath = Dir + "/stats";
+    if (!sys::fs::openFileForReadWrite(StatsPath, FD, sys::fs::CD_OpenAlways, sys::fs::OF_None)) {
+        if (!sys::fs::lockFile(FD)) {
+            auto Buffer = MemoryBuffer::getOpenFile(FD, StatsPath, -1);
+            unsigned long long StoredHits = 0, StoredMisses = 0;
+            if (Buffer)
+                sscanf((*Buffer)->getBuffer().str().c_str(), "%llu %llu", &StoredHits, &StoredMisses);
+            TotalHits += StoredHits;
+            TotalMisses += StoredMisses;
+
+            raw_fd_ostream Out(FD, false);
+            Out.seek(0);
+            Out << TotalHits << " " << TotalMisses << "\n";
+            Out.flush();
+            sys::fs::resize_file(FD, Out.tell());
+            sys::fs::unlockFile(FD);
+        }
+        sys::fs::closeFile(FD);
+    }
+
+    auto Rate = [](unsigned long long H, unsigned long long M) {
+        return H + M ? 100.0 * (double) H / (double) (H + M) : 0.0;
+    };
+
+    char Line[256];
+    snprintf(Line, sizeof(Line), "cache: %u hits, %u misses (%.1f%% hit rate); all runs: %llu hits, %llu misses (%.1f%%)",
+             Hits.load(), Misses.load(), Rate(Hits, Misses), TotalHits, TotalMisses, Rate(TotalHits, TotalMisses));
+    OS << Line << std::endl;
+}
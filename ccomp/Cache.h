@@ -0,0 +1,46 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/StringRef.h"
+
+using namespace llvm;
+
+// On-disk object cache keyed by a hash of everything that determines the
+// object: source bytes, compiler build and the options that affect codegen.
+// Entries are published with an atomic rename, so concurrent compilers
+// only ever see complete objects, and the least recently used ones are
+// evicted once the directory grows beyond MaxBytes.
+class CompileCache {
+public:
+    CompileCache(std::string Dir, uint64_t MaxBytes);
+
+    std::string Dir;
+    uint64_t MaxBytes;
+
+    std::atomic<unsigned> Hits;
+    std::atomic<unsigned> Misses;
+
+    bool Init(std::string &Msg);
+
+    std::string ComputeKey(StringRef Source, const std::vector<std::string> &Options) const;
+
+    // Copies the cached object for Key to ObjectPath.
+    bool Lookup(const std::string &Key, const std::string &ObjectPath);
+
+    void Store(const std::string &Key, const std::string &ObjectPath);
+
+    void Prune();
+
+    // Adds this run's counters to the persistent ones and prints both.
+    void ReportStats(std::ostream &OS);
+
+private:
+    std::string EntryPath(const std::string &Key) const;
+};
+
+#endif
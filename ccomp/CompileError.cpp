@@ -0,0 +1,4 @@
+#include "CompileError.h"
+
+CompileError::CompileError(size_t Row, size_t Column, const std::string &Msg) : std::runtime_error(Msg), Row(Row),
+                                                                                 Column(Column) {}
@@ -0,0 +1,16 @@
+#ifndef COMPILE_ERROR_H
+#define COMPILE_ERROR_H
+
+#include <stdexcept>
+#include <string>
+
+// Thrown by the parser, code generator and interpreter so that a failing
+// translation unit is reported without tearing down the whole driver.
+class CompileError : public std::runtime_error {
+public:
+    size_t Row, Column;
+
+    CompileError(size_t Row, size_t Column, const std::string &Msg);
+};
+
+#endif
@@ -0,0 +1,633 @@
+#include "Fold.h"
+
+#include <cmath>
+#include <cstdint>
+
+static bool TryGetInteger(PNode *Node, int64_t *Value) {
+    auto Int = dynamic_cast<IntegerNode *>(Node);
+    if (!Int)
+        return false;
+    // Literals keep their bits unsigned, narrow ones are sign extended back
+    auto Shift = 64 - std::min<size_t>(Int->NumBits, 64);
+    *Value = (int64_t) (Int->Value << Shift) >> Shift;
+    return true;
+}
+
+static bool TryGetFloat(PNode *Node, double *Value) {
+    if (auto Float = dynamic_cast<FloatNode *>(Node)) {
+        *Value = Float->Value;
+        return true;
+    }
+
+    int64_t Int;
+    if (!TryGetInteger(Node, &Int))
+        return false;
+    *Value = (double) Int;
+    return true;
+}
+
+// Whether Value fits in the integer Type
+static bool IsRepresentable(CType *Type, int64_t Value) {
+    if (!Type->IsSigned || Type->Size >= 8)
+        return true;
+    auto Limit = INT64_C(1) << (Type->Size * 8 - 1);
+    return Value >= -Limit && Value < Limit;
+}
+
+static bool IsConstant(PNode *Node) {
+    return dynamic_cast<IntegerNode *>(Node) || dynamic_cast<FloatNode *>(Node);
+}
+
+static bool HasSideEffects(PNode *Node) {
+    if (dynamic_cast<CallNode *>(Node) || dynamic_cast<AssignNode *>(Node) || dynamic_cast<AllocNode *>(Node))
+        return true;
+    for (auto Child: Node->GetChildren())
+        if (HasSideEffects(Child))
+            return true;
+    return false;
+}
+
+static void CollectMutated(PNode *Node, std::set<std::string> &Names) {
+    if (auto Assign = dynamic_cast<AssignNode *>(Node); Assign && Assign->Ident)
+        Names.insert(Assign->Ident->Name);
+    if (auto Ref = dynamic_cast<RefNode *>(Node))
+        if (auto Ident = dynamic_cast<IdentifierNode *>(Ref->Expr); Ident && !Ref->IsDeref)
+            Names.insert(Ident->Name);
+
+    for (auto Child: Node->GetChildren())
+        CollectMutated(Child, Names);
+}
+
+// Whether Node computes only on scalar locals and calls Callees. Such code
+// can neither observe nor change anything outside its call, and cannot reach
+// memory the evaluator does not own.
+static bool IsEvaluable(PNode *Node, SymbolTable<AllocNode *> &Locals, const std::map<std::string,
+                        PrototypeNode *> &Callees) {
+    if (!Node || IsConstant(Node))
+        return true;
+
+    if (auto Ident = dynamic_cast<IdentifierNode *>(Node)) {
+        // Anything not declared in the function is a global
+        AllocNode *Alloc;
+        return !Ident->IndexExpr && Locals.TryGet(Ident->Name, &Alloc);
+    }
+    if (auto Alloc = dynamic_cast<AllocNode *>(Node)) {
+        Locals.TryPut(Alloc->Name, Alloc);
+        return !Alloc->ArraySizeExpr && Alloc->Type->IsArithmetic();
+    }
+    if (auto Assign = dynamic_cast<AssignNode *>(Node)) {
+        return IsEvaluable(Assign->Alloc, Locals, Callees) && IsEvaluable(Assign->Ident, Locals, Callees)
+               && IsEvaluable(Assign->Expr, Locals, Callees);
+    }
+    if (auto Call = dynamic_cast<CallNode *>(Node)) {
+        if (!Callees.count(Call->CalleeName) && !Call->IsBuiltinExpect())
+            return false;
+    } else if (!dynamic_cast<BinOpNode *>(Node) && !dynamic_cast<UnOpNode *>(Node)
+               && !dynamic_cast<BlockNode *>(Node) && !dynamic_cast<IfNode *>(Node)
+               && !dynamic_cast<ForNode *>(Node) && !dynamic_cast<ReturnNode *>(Node))
+        return false;
+
+    bool Scoped = dynamic_cast<BlockNode *>(Node) || dynamic_cast<ForNode *>(Node);
+    if (Scoped)
+        Locals.PushScope();
+    bool Result = true;
+    for (auto Child: Node->GetChildren())
+        if (!(Result = IsEvaluable(Child, Locals, Callees)))
+            break;
+    if (Scoped)
+        Locals.PopScope();
+    return Result;
+}
+
+static void CollectCallees(PNode *Node, std::set<std::string> &Names) {
+    if (auto Call = dynamic_cast<CallNode *>(Node))
+        Names.insert(Call->CalleeName);
+    for (auto Child: Node->GetChildren())
+        CollectCallees(Child, Names);
+}
+
+// Budgets of compile-time evaluation. A step costs the interpreter a few
+// microseconds, so a translation unit spends at most a few seconds on it.
+static const size_t EvaluatorStackSize = 64 << 10;
+static const uint64_t EvaluationSteps = 1 << 16;
+static const uint64_t TranslationUnitSteps = 1 << 20;
+static const size_t EvaluationDepth = 256;
+
+Folder::Folder() : InFunction(false), Statement(nullptr), Evaluator(EvaluatorStackSize), StepsLeft(TranslationUnitSteps) {
+    Evaluator.DepthLimit = EvaluationDepth;
+}
+
+void Folder::Run(PNode *Root) {
+    Declarations.PushScope();
+    if (auto Block = dynamic_cast<BlockNode *>(Root)) {
+        FindEvaluable(Block);
+        for (auto &Node: Block->Nodes) {
+            Statement = Node;
+            Fold(Node);
+        }
+        Statement = nullptr;
+    } else
+        Fold(Root);
+    Declarations.PopScope();
+}
+
+void Folder::FindEvaluable(BlockNode *Root) {
+    for (auto Node: Root->Nodes) {
+        auto Proto = dynamic_cast<PrototypeNode *>(Node);
+        if (!Proto && !dynamic_cast<StructNode *>(Node) && !dynamic_cast<TypedefNode *>(Node))
+            continue;
+
+        // The evaluator knows every function and type, it runs none of the file-scope code
+        Node->Eval(&Evaluator);
+        if (!Proto || !Proto->BodyExpr || Proto->IsVarArg || !Proto->Type->IsArithmetic())
+            continue;
+        bool Scalar = true;
+        for (auto Param: Proto->Params)
+            Scalar = Scalar && Param->Type->IsArithmetic();
+        if (Scalar)
+            Evaluable[Proto->Name] = Proto;
+    }
+
+    // A function stays evaluable while everything it calls does
+    bool Changed = true;
+    while (Changed) {
+        Changed = false;
+        for (auto It = Evaluable.begin(); It != Evaluable.end();) {
+            SymbolTable<AllocNode *> Locals;
+            Locals.PushScope();
+            for (auto Param: It->second->Params)
+                Locals.TryPut(Param->Name, Param);
+            if (IsEvaluable(It->second->BodyExpr, Locals, Evaluable)) {
+                ++It;
+                continue;
+            }
+            It = Evaluable.erase(It);
+            Changed = true;
+        }
+    }
+
+    for (auto &[Name, Proto]: Evaluable)
+        CollectCallees(Proto->BodyExpr, EvaluableCallees[Name]);
+}
+
+void Folder::Fold(PNode *&Node) {
+    if (!Node)
+        return;
+    auto Result = Node->Fold(this);
+    if (Result != Node) {
+        delete Node;
+        Node = Result;
+    }
+}
+
+void Folder::Declare(AllocNode *Alloc, PNode *Value) {
+    Declarations.TryPut(Alloc->Name, Alloc);
+    if (Value) {
+        Values.emplace_back(Value);
+        Constants[Alloc] = Value;
+    }
+}
+
+void Folder::DeclareReadOnly(AllocNode *Alloc, PNode *Init) {
+    auto List = dynamic_cast<InitListNode *>(Init);
+    auto ElementType = List ? Alloc->Type->Base : Alloc->Type;
+    if (!ElementType->IsArithmetic() || (!List && Alloc->Type->IsArray()))
+        return;
+
+    std::vector<PNode *> Elements;
+    for (auto Element: List ? List->Elements : std::vector<PNode *>{Init}) {
+        auto Value = IsConstant(Element) ? Convert(Element, ElementType) : nullptr;
+        if (!Value)
+            return;
+        Values.emplace_back(Value);
+        Elements.push_back(Value);
+    }
+    ReadOnly[Alloc] = std::move(Elements);
+}
+
+PNode *Folder::GetConstant(const std::string &Name) {
+    AllocNode *Alloc;
+    if (!Declarations.TryGet(Name, &Alloc) || !Alloc)
+        return nullptr;
+
+    // Sema rejects every store to a const global
+    if (auto Global = ReadOnly.find(Alloc); Global != ReadOnly.end()) {
+        if (Alloc->Type->IsArray())
+            return nullptr;
+        if (Statement)
+            Statement->FoldedGlobals.insert(Name);
+        return Global->second.front();
+    }
+
+    if (!InFunction || Mutated.count(Name))
+        return nullptr;
+    auto Result = Constants.find(Alloc);
+    return Result != Constants.end() ? Result->second : nullptr;
+}
+
+PNode *Folder::GetElement(IdentifierNode *Ident, int64_t Index) {
+    AllocNode *Alloc;
+    if (!Declarations.TryGet(Ident->Name, &Alloc) || !Alloc)
+        return nullptr;
+    auto Global = ReadOnly.find(Alloc);
+    // Reads out of bounds are left to run time
+    if (Global == ReadOnly.end() || !Alloc->Type->IsArray() || Index < 0 || (uint64_t) Index >= Alloc->Type->Count)
+        return nullptr;
+
+    if (Statement)
+        Statement->FoldedGlobals.insert(Ident->Name);
+    if ((uint64_t) Index < Global->second.size())
+        return Convert(Global->second[Index], Ident->Type);
+    // Elements past the initializer list are zero
+    if (Ident->Type->IsFloat())
+        return MakeFloat(Ident, Ident->Type, 0);
+    return MakeInteger(Ident, Ident->Type, 0);
+}
+
+PNode *Folder::MakeInteger(PNode *RelatedNode, CType *Type, int64_t Value) {
+    // Wraps to the width of the type, as the generated code would
+    auto Shift = 64 - Type->Size * 8;
+    Value = (int64_t) ((uint64_t) Value << Shift) >> Shift;
+
+    auto Node = new IntegerNode((uint64_t) Value, Type->Size * 8);
+    Node->Row = RelatedNode->Row;
+    Node->Column = RelatedNode->Column;
+    Node->Type = Type;
+    return Node;
+}
+
+PNode *Folder::MakeFloat(PNode *RelatedNode, CType *Type, double Value) {
+    auto Node = new FloatNode(Type->Size == 4 ? (double) (float) Value : Value);
+    Node->Row = RelatedNode->Row;
+    Node->Column = RelatedNode->Column;
+    Node->Type = Type;
+    return Node;
+}
+
+PNode *Folder::Convert(PNode *Const, CType *Type) {
+    int64_t Int;
+    double Float;
+    if (Type->IsInteger()) {
+        if (TryGetInteger(Const, &Int))
+            return MakeInteger(Const, Type, Int);
+        // Out of range conversions are undefined and left to run time
+        if (TryGetFloat(Const, &Float) && std::isfinite(Float) && std::fabs(Float) < 9.2e18)
+            return MakeInteger(Const, Type, (int64_t) Float);
+    } else if (Type->IsFloat() && TryGetFloat(Const, &Float))
+        return MakeFloat(Const, Type, Float);
+    return nullptr;
+}
+
+PNode *Folder::TryEvaluate(CallNode *Call) {
+    auto Result = Evaluable.find(Call->CalleeName);
+    if (Result == Evaluable.end() || !StepsLeft)
+        return nullptr;
+
+    std::vector<IValue> Args;
+    for (auto ArgExpr: Call->ArgExprs) {
+        if (!IsConstant(ArgExpr))
+            return nullptr;
+        Args.push_back(ArgExpr->Eval(&Evaluator));
+    }
+
+    Evaluator.StepLimit = std::min(EvaluationSteps, StepsLeft);
+    IValue Value;
+    bool Evaluated = Evaluator.TryEvaluate(Result->second, Args, &Value);
+    StepsLeft -= std::min(Evaluator.Steps, StepsLeft);
+    if (!Evaluated)
+        return nullptr;
+
+    AddEvaluated(Call->CalleeName);
+    if (Call->Type->IsFloat())
+        return MakeFloat(Call, Call->Type, Value.As.Float);
+    return MakeInteger(Call, Call->Type, Value.As.Int);
+}
+
+void Folder::AddEvaluated(const std::string &Name) {
+    // The statement now depends on the bodies of everything the call could run
+    if (!Statement || !Statement->EvaluatedFunctions.insert(Name).second)
+        return;
+    for (const auto &Callee: EvaluableCallees[Name])
+        AddEvaluated(Callee);
+}
+
+PNode *IdentifierNode::Fold(Folder *F) {
+    F->Fold(IndexExpr);
+    if (IndexExpr) {
+        int64_t Index;
+        auto Element = TryGetInteger(IndexExpr, &Index) ? F->GetElement(this, Index) : nullptr;
+        if (!Element)
+            return this;
+        Element->Row = Row;
+        Element->Column = Column;
+        return Element;
+    }
+
+    auto Const = F->GetConstant(Name);
+    if (!Const)
+        return this;
+
+    auto Copy = F->Convert(Const, Type);
+    Copy->Row = Row;
+    Copy->Column = Column;
+    return Copy;
+}
+
+PNode *BinOpNode::Fold(Folder *F) {
+    F->Fold(LHS);
+    F->Fold(RHS);
+
+    int64_t L, R;
+    double LF, RF;
+
+    // Logical operators are decided by the left operand alone when it is constant
+    if (OpType == TType::AND || OpType == TType::OR) {
+        if (!TryGetFloat(LHS, &LF))
+            return this;
+        bool LTrue = LF != 0;
+        if (LTrue == (OpType == TType::OR))
+            return F->MakeInteger(this, Type, LTrue);
+        if (!TryGetFloat(RHS, &RF))
+            return this;
+        return F->MakeInteger(this, Type, RF != 0);
+    }
+
+    if (OperandType->IsPointer())
+        return this;
+
+    if (OperandType->IsFloat()) {
+        if (!TryGetFloat(LHS, &LF) || !TryGetFloat(RHS, &RF))
+            return this;
+        switch (OpType) {
+            case TType::PLUS:
+                return F->MakeFloat(this, Type, LF + RF);
+            case TType::MINUS:
+                return F->MakeFloat(this, Type, LF - RF);
+            case TType::STAR:
+                return F->MakeFloat(this, Type, LF * RF);
+            case TType::SLASH:
+                return F->MakeFloat(this, Type, LF / RF);
+            case TType::D_EQUAL:
+                return F->MakeInteger(this, Type, LF == RF);
+            case TType::BANG_EQ:
+                return F->MakeInteger(this, Type, LF != RF);
+            case TType::LESS:
+                return F->MakeInteger(this, Type, LF < RF);
+            case TType::LESS_EQ:
+                return F->MakeInteger(this, Type, LF <= RF);
+            case TType::GREAT:
+                return F->MakeInteger(this, Type, LF > RF);
+            case TType::GREAT_EQ:
+                return F->MakeInteger(this, Type, LF >= RF);
+            default:
+                return this;
+        }
+    }
+
+    bool LConst = TryGetInteger(LHS, &L);
+    bool RConst = TryGetInteger(RHS, &R);
+
+    if (!LConst || !RConst) {
+        // The remaining operand replaces the node only when it already has the result type
+        auto Keep = [this](PNode *&Operand) -> PNode * {
+            if (Operand->Type != Type)
+                return this;
+            auto Result = Operand;
+            Operand = nullptr;
+            return Result;
+        };
+        auto Zero = [this, F](PNode *Operand) -> PNode * {
+            if (HasSideEffects(Operand))
+                return this;
+            return F->MakeInteger(this, Type, 0);
+        };
+
+        switch (OpType) {
+            case TType::PLUS:
+                if (LConst && L == 0)
+                    return Keep(RHS);
+                if (RConst && R == 0)
+                    return Keep(LHS);
+                break;
+            case TType::MINUS:
+                if (RConst && R == 0)
+                    return Keep(LHS);
+                break;
+            case TType::STAR:
+                if (LConst && L == 1)
+                    return Keep(RHS);
+                if (RConst && R == 1)
+                    return Keep(LHS);
+                if (LConst && L == 0)
+                    return Zero(RHS);
+                if (RConst && R == 0)
+                    return Zero(LHS);
+                break;
+            case TType::SLASH:
+                if (RConst && R == 1)
+                    return Keep(LHS);
+                break;
+            case TType::BIN_OR:
+                if (LConst && L == 0)
+                    return Keep(RHS);
+                if (RConst && R == 0)
+                    return Keep(LHS);
+                break;
+            case TType::BIN_AND:
+                if (LConst && L == 0)
+                    return Zero(RHS);
+                if (RConst && R == 0)
+                    return Zero(LHS);
+                break;
+            default:
+                break;
+        }
+        return this;
+    }
+
+    // Signed overflow and division by zero are undefined, they are left for
+    // run time rather than given a value here. Unsigned results wrap.
+    int64_t Result;
+    switch (OpType) {
+        case TType::PLUS:
+        case TType::MINUS:
+        case TType::STAR: {
+            bool Overflow = OpType == TType::PLUS ? __builtin_add_overflow(L, R, &Result)
+                            : OpType == TType::MINUS ? __builtin_sub_overflow(L, R, &Result)
+                            : __builtin_mul_overflow(L, R, &Result);
+            if (Type->IsSigned && (Overflow || !IsRepresentable(Type, Result)))
+                return this;
+            return F->MakeInteger(this, Type, Result);
+        }
+        case TType::SLASH:
+        case TType::PERCENT:
+            if (R == 0 || (R == -1 && L == INT64_MIN) || (Type->IsSigned && !IsRepresentable(Type, L / R)))
+                return this;
+            return F->MakeInteger(this, Type, OpType == TType::SLASH ? L / R : L % R);
+        case TType::BIN_OR:
+            return F->MakeInteger(this, Type, L | R);
+        case TType::BIN_AND:
+            return F->MakeInteger(this, Type, L & R);
+        case TType::D_EQUAL:
+            return F->MakeInteger(this, Type, L == R);
+        case TType::BANG_EQ:
+            return F->MakeInteger(this, Type, L != R);
+        case TType::LESS:
+            return F->MakeInteger(this, Type, L < R);
+        case TType::LESS_EQ:
+            return F->MakeInteger(this, Type, L <= R);
+        case TType::GREAT:
+            return F->MakeInteger(this, Type, L > R);
+        case TType::GREAT_EQ:
+            return F->MakeInteger(this, Type, L >= R);
+        default:
+            return this;
+    }
+}
+
+PNode *UnOpNode::Fold(Folder *F) {
+    F->Fold(Expr);
+
+    int64_t Int;
+    double Float;
+    if (OpType == TType::BANG && TryGetFloat(Expr, &Float))
+        return F->MakeInteger(this, Type, Float == 0);
+    if (OpType != TType::MINUS)
+        return this;
+    if (TryGetInteger(Expr, &Int)) {
+        if (Type->IsSigned && (Int == INT64_MIN || !IsRepresentable(Type, -Int)))
+            return this;
+        return F->MakeInteger(this, Type, (int64_t) (0 - (uint64_t) Int));
+    }
+    if (TryGetFloat(Expr, &Float))
+        return F->MakeFloat(this, Type, -Float);
+    return this;
+}
+
+PNode *AssignNode::Fold(Folder *F) {
+    if (!Alloc) {
+        F->Fold(Ident->IndexExpr);
+        F->Fold(Expr);
+        return this;
+    }
+
+    // The initializer sees the variable it initializes, as in Sema
+    F->Fold(Alloc->ArraySizeExpr);
+    F->Declare(Alloc, nullptr);
+    F->Fold(Expr);
+
+    if (!F->InFunction && Alloc->IsConst())
+        F->DeclareReadOnly(Alloc, Expr);
+    else if (F->InFunction && Alloc->Type->IsArithmetic() && IsConstant(Expr))
+        F->Declare(Alloc, F->Convert(Expr, Alloc->Type));
+    return this;
+}
+
+PNode *InitListNode::Fold(Folder *F) {
+    for (auto &Element: Elements)
+        F->Fold(Element);
+    return this;
+}
+
+PNode *RefNode::Fold(Folder *F) {
+    // The operand of & names an object, it must not become its value
+    if (IsDeref)
+        F->Fold(Expr);
+    else if (auto Ident = dynamic_cast<IdentifierNode *>(Expr))
+        F->Fold(Ident->IndexExpr);
+    return this;
+}
+
+PNode *AllocNode::Fold(Folder *F) {
+    F->Fold(ArraySizeExpr);
+    F->Declare(this, nullptr);
+    return this;
+}
+
+PNode *BlockNode::Fold(Folder *F) {
+    F->Declarations.PushScope();
+    for (auto &Node: Nodes)
+        F->Fold(Node);
+    F->Declarations.PopScope();
+    return this;
+}
+
+PNode *IfNode::Fold(Folder *F) {
+    F->Fold(CondExpr);
+
+    double Cond;
+    if (!TryGetFloat(CondExpr, &Cond)) {
+        F->Fold(BodyExpr);
+        F->Fold(ElseBrExpr);
+        return this;
+    }
+
+    // Only the branch that is taken survives. It is folded in place first, the
+    // evaluator may run this function while it is being folded.
+    auto &Taken = Cond != 0 ? BodyExpr : ElseBrExpr;
+    bool Lone = !dynamic_cast<BlockNode *>(Taken);
+    // A lone statement keeps the scope the if statement gave it
+    if (Lone)
+        F->Declarations.PushScope();
+    F->Fold(Taken);
+    if (Lone)
+        F->Declarations.PopScope();
+
+    PNode *Result = Taken;
+    Taken = nullptr;
+    if (Lone) {
+        auto Block = new BlockNode();
+        Block->Row = CondExpr->Row;
+        Block->Column = CondExpr->Column;
+        Block->Type = Type;
+        if (Result)
+            Block->Nodes.push_back(Result);
+        Result = Block;
+    }
+    return Result;
+}
+
+PNode *ForNode::Fold(Folder *F) {
+    F->Declarations.PushScope();
+    F->Fold(InitExpr);
+    F->Fold(CondExpr);
+    F->Fold(UpdateExpr);
+    F->Fold(BodyExpr);
+    F->Declarations.PopScope();
+    return this;
+}
+
+PNode *CallNode::Fold(Folder *F) {
+    for (auto &ArgExpr: ArgExprs)
+        F->Fold(ArgExpr);
+    if (IsBuiltinExpect()) {
+        auto Result = IsConstant(ArgExprs[0]) ? F->Convert(ArgExprs[0], Type) : nullptr;
+        return Result ? Result : this;
+    }
+    auto Result = F->TryEvaluate(this);
+    return Result ? Result : this;
+}
+
+PNode *PrototypeNode::Fold(Folder *F) {
+    if (!BodyExpr)
+        return this;
+
+    F->InFunction = true;
+    F->Mutated.clear();
+    CollectMutated(BodyExpr, F->Mutated);
+
+    F->Declarations.PushScope();
+    for (auto Param: Params)
+        F->Declare(Param, nullptr);
+    F->Fold(BodyExpr);
+    F->Declarations.PopScope();
+
+    F->InFunction = false;
+    F->Constants.clear();
+    return this;
+}
+
+PNode *ReturnNode::Fold(Folder *F) {
+    F->Fold(Expr);
+    return this;
+}
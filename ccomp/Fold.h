@@ -0,0 +1,84 @@
+#ifndef FOLD_H
+#define FOLD_H
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "Interp.h"
+#include "Sema.h"
+#include "SymbolTable.h"
+
+// Rewrites a checked tree in place: constant integer and floating point
+// subexpressions become literals, integer identities such as x * 1 and x + 0
+// are simplified and an if statement with a constant condition is replaced
+// by the branch it takes. Locals that are initialized with a constant and
+// never assigned again or have their address taken are propagated, and so are
+// const globals, including elements of const arrays read at a constant index.
+//
+// Calls with constant arguments to functions that only compute on scalar locals
+// are run by the interpreter and replaced by their result. Every evaluation has
+// a step and a call depth budget, and a call that exceeds one, divides by zero
+// or overflows the evaluator stack is left for run time.
+class Folder {
+public:
+    Folder();
+
+    // Declaration each visible local name refers to
+    SymbolTable<AllocNode *> Declarations;
+    // Known values of effectively constant locals, owned by the folder
+    std::map<AllocNode *, PNode *> Constants;
+    // Element values of const globals with constant initializers, a scalar has
+    // one. They are owned by the folder and known in every function.
+    std::map<AllocNode *, std::vector<PNode *>> ReadOnly;
+    // Names assigned or address-taken anywhere in the current function
+    std::set<std::string> Mutated;
+    bool InFunction;
+
+    // Definitions that are safe to evaluate at compile time
+    std::map<std::string, PrototypeNode *> Evaluable;
+    // Top-level statement being folded
+    PNode *Statement;
+
+    void Run(PNode *Root);
+
+    // Finds the definitions of Root that neither observe nor change anything outside a call
+    void FindEvaluable(BlockNode *Root);
+
+    // Folds Node and replaces it with the result
+    void Fold(PNode *&Node);
+
+    void Declare(AllocNode *Alloc, PNode *Value);
+
+    void DeclareReadOnly(AllocNode *Alloc, PNode *Init);
+
+    PNode *GetConstant(const std::string &Name);
+
+    // Value of element Index of a const global array read by Ident, null if unknown
+    PNode *GetElement(IdentifierNode *Ident, int64_t Index);
+
+    PNode *MakeInteger(PNode *RelatedNode, CType *Type, int64_t Value);
+
+    PNode *MakeFloat(PNode *RelatedNode, CType *Type, double Value);
+
+    // Converts a literal to Type, null if the result is not representable
+    PNode *Convert(PNode *Const, CType *Type);
+
+    // Result of Call when its arguments are constant and its callee evaluable, null otherwise
+    PNode *TryEvaluate(CallNode *Call);
+
+private:
+    std::vector<std::unique_ptr<PNode>> Values;
+
+    Interp Evaluator;
+    // Evaluable functions each evaluable function calls
+    std::map<std::string, std::set<std::string>> EvaluableCallees;
+    // Steps left for the rest of the translation unit
+    uint64_t StepsLeft;
+
+    void AddEvaluated(const std::string &Name);
+};
+
+#endif
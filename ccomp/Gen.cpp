@@ -1,25 +1,27 @@
 #include "Gen.h"
 
-GScope::GScope(GScope *Parent) {
-    this->Parent = Parent;
-}
-
 Value *Gen::ThrowError(PNode *RelatedNode, std::string Text) {
-    std::cerr << "error at " << RelatedNode->Row + 1 << ":" << RelatedNode->Column + 1 << ": " << Text << std::endl;
-    exit(1);
-}
-
-GStruct::GStruct(std::vector<std::string> VarNames, std::vector<Type *> VarTypes, StructType *StrType) : VarNames(std::move(VarNames)),
-                                                                                                         VarTypes(std::move(VarTypes)),
-                                                                                                         StrType(StrType) {
+    throw CompileError(RelatedNode->Row, RelatedNode->Column,
+                       "error at " + std::to_string(RelatedNode->Row + 1) + ":"
+                       + std::to_string(RelatedNode->Column + 1) + ": " + Text);
 }
 
 Gen::Gen() {
     Context = new LLVMContext();
+#if LLVM_VERSION_MAJOR < 15
+    // Pointers are typed by default before LLVM 15, everything here is opaque
+    Context->enableOpaquePointers();
+#endif
     MainModule = new Module("main", *Context);
     Builder = new IRBuilder<>(*Context);
 
-    CurScope = nullptr;
+    DefinitionFilter = nullptr;
+    DirectSSA = false;
+    FastMath = false;
+    DebugInfo = DebugInfoKind::NONE;
+    CompileUnit = nullptr;
+    DebugFile = nullptr;
+    Subprogram = nullptr;
 
     TVoid = Type::getVoidTy(*Context);
     TInt8 = Type::getInt8Ty(*Context);
@@ -29,25 +31,46 @@ Gen::Gen() {
     TFloat32 = Type::getFloatTy(*Context);
     TFloat64 = Type::getDoubleTy(*Context);
     TPtr = PointerType::getUnqual(*Context);
-
-    Types.emplace("void", TVoid);
-    Types.emplace("char", TInt8);
-    Types.emplace("short", TInt16);
-    Types.emplace("int", TInt32);
-    Types.emplace("long", TInt64);
-    Types.emplace("float", TFloat32);
-    Types.emplace("double", TFloat64);
 }
 
 void Gen::Generate(PNode *Node) {
+    if (FastMath) {
+        FastMathFlags Flags;
+        Flags.setFast();
+        Builder->setFastMathFlags(Flags);
+    }
+
+    if (DebugInfo != DebugInfoKind::NONE) {
+        DebugBuilder = std::make_unique<DIBuilder>(*MainModule);
+        // Locations name the file as it was given, relative to the working directory
+        SmallString<128> Directory;
+        sys::fs::current_path(Directory);
+        DebugFile = DebugBuilder->createFile(MainModule->getSourceFileName(), Directory);
+        auto Kind = DebugInfo == DebugInfoKind::FULL ? DICompileUnit::FullDebug
+                    : DebugInfo == DebugInfoKind::LINE_TABLES ? DICompileUnit::LineTablesOnly : DICompileUnit::NoDebug;
+        CompileUnit = DebugBuilder->createCompileUnit(dwarf::DW_LANG_C99, DebugFile, "ccomp", false, "", 0,
+                                                      StringRef(), Kind);
+        MainModule->addModuleFlag(Module::Warning, "Debug Info Version", DEBUG_METADATA_VERSION);
+        if (Kind != DICompileUnit::NoDebug)
+            MainModule->addModuleFlag(Module::Warning, "Dwarf Version", 4);
+    }
+
     // Pushing Global scope
     PushScope();
     Node->Emit(this);
     PopScope();
+
+    if (DebugBuilder)
+        DebugBuilder->finalize();
+}
+
+Gen::~Gen() {
+    delete Builder;
+    delete MainModule;
+    delete Context;
 }
 
 void Gen::Save(const std::string &Path) const {
-    MainModule->dump();
     std::string Str;
     raw_string_ostream OS(Str);
     OS << *MainModule;
@@ -58,122 +81,702 @@ void Gen::Save(const std::string &Path) const {
     Out.close();
 }
 
-void Gen::PushScope() {
-    CurScope = new GScope(CurScope);
+void Gen::PushScope(PNode *Node) {
+    DIScope *DebugScope = nullptr;
+    if (Node && Subprogram && DebugInfo == DebugInfoKind::FULL)
+        DebugScope = DebugBuilder->createLexicalBlock(GetDebugScope(), DebugFile, Node->Row + 1, Node->Column + 1);
+
+    Scopes.push_back({nullptr, DebugScope});
+    Symbols.PushScope();
 }
 
 void Gen::PopScope() {
-    auto OldScope = CurScope;
-    CurScope = CurScope->Parent;
-    delete OldScope;
+    // Variable length arrays of the scope are released when control leaves it
+    auto StackSave = Scopes.back().StackSave;
+    if (StackSave && !IsFileScope() && !IsTerminated())
+        Builder->CreateCall(Intrinsic::getDeclaration(MainModule, Intrinsic::stackrestore), {StackSave});
+
+    Scopes.pop_back();
+    Symbols.PopScope();
 }
 
-bool Gen::TryPutStruct(const std::string Name, GStruct *Str) {
-    return CurScope->Structs.try_emplace(Name, Str).second;
+bool Gen::ShouldDefine(const std::string &Name) const {
+    return !DefinitionFilter || DefinitionFilter->count(Name);
 }
 
-bool Gen::TryGetStruct(const std::string Name, GStruct **StrPtr) {
-    GScope *Scope = CurScope;
-    while (Scope) {
-        auto Result = Scope->Structs.find(Name);
+std::string Gen::GetLinkName(PrototypeNode *Proto) const {
+    // The units of an incremental build are linked together, so a static
+    // function stays external there, under a name no other file uses
+    if (!Proto->IsStatic || !DefinitionFilter)
+        return Proto->Name;
+    return Proto->Name + "." + utohexstr(MD5Hash(MainModule->getSourceFileName()));
+}
 
-        if (Result != Scope->Structs.end()) {
-            *StrPtr = Result->second;
-            return true;
-        } else
-            Scope = Scope->Parent;
+Function *Gen::GetFunction(PrototypeNode *Proto, FunctionType *FuncType, bool Define) {
+    auto Func = cast<Function>(MainModule->getOrInsertFunction(GetLinkName(Proto), FuncType).getCallee());
+    // Only direct calls reach a static function, so it needs no C calling
+    // convention. Declarations agree with the definition for calls before it.
+    if (Proto->IsStatic)
+        Func->setCallingConv(CallingConv::Fast);
+    // C has no exceptions
+    Func->setDoesNotThrow();
+    // Inlining turns these into alias scopes of the copied body
+    for (size_t i = 0; i < Proto->Params.size(); i++)
+        if (Proto->Params[i]->IsRestrict)
+            Func->addParamAttr(i, Attribute::NoAlias);
+    // Sema rejects stores through a pointer to const, and assigning, passing or
+    // returning it as a plain pointer
+    for (size_t i = 0; i < Proto->Params.size(); i++)
+        if (Proto->Params[i]->IsPointeeConst())
+            Func->addParamAttr(i, Attribute::ReadOnly);
+    if (!Define) {
+        if (!LibraryInfo)
+            LibraryInfo = std::make_unique<TargetLibraryInfoImpl>(Triple(sys::getDefaultTargetTriple()));
+        inferLibFuncAttributes(*Func, TargetLibraryInfo(*LibraryInfo));
+        return Func;
     }
-    return false;
+
+    if (Proto->IsStatic && !DefinitionFilter)
+        Func->setLinkage(GlobalValue::InternalLinkage);
+    else if (Proto->IsStatic)
+        Func->setVisibility(GlobalValue::HiddenVisibility);
+    // Callers in the other units of an incremental build need the body kept
+    else if (Proto->IsInline)
+        Func->setLinkage(DefinitionFilter ? GlobalValue::WeakODRLinkage : GlobalValue::LinkOnceODRLinkage);
+    return Func;
 }
 
-bool Gen::TryPutValue(const std::string Name, AllocaInst *Alloca) {
-    return CurScope->Allocas.try_emplace(Name, Alloca).second;
+// Whether the body touches no memory of its callers or only reads it
+static void InferMemoryEffects(Function *Func) {
+    bool Reads = false;
+    for (auto &Inst: instructions(Func)) {
+        if (!Inst.mayReadOrWriteMemory())
+            continue;
+
+        // Local variables are invisible to callers
+        auto Ptr = getLoadStorePointerOperand(&Inst);
+        if (Ptr && isa<AllocaInst>(getUnderlyingObject(Ptr)))
+            continue;
+
+        if (auto Call = dyn_cast<CallBase>(&Inst)) {
+            // Recursion has the effects of the rest of the body
+            if (Call->getCalledFunction() == Func || Call->doesNotAccessMemory())
+                continue;
+            if (!Call->onlyReadsMemory())
+                return;
+            Reads = true;
+        } else if (isa<LoadInst>(Inst) && !cast<LoadInst>(Inst).isVolatile())
+            Reads = true;
+        else
+            return;
+    }
+
+    if (Reads)
+        Func->setOnlyReadsMemory();
+    else
+        Func->setDoesNotAccessMemory();
 }
 
-bool Gen::TryGetValue(const std::string Name, AllocaInst **AllocaPtr) {
-    GScope *Scope = CurScope;
-    while (Scope) {
-        auto Result = Scope->Allocas.find(Name);
+// Pointer parameters the entry block dereferences before anything that may
+// not return are nonnull, and dereferenceable for the accesses at offset zero
+static void InferDereferenceable(Function *Func) {
+    // Without -fssa a parameter is stored to its slot once and loaded from there
+    std::map<Value *, Argument *> Copies;
+    for (auto &Arg: Func->args()) {
+        if (!Arg.getType()->isPointerTy())
+            continue;
+        Copies[&Arg] = &Arg;
+        for (auto User: Arg.users()) {
+            auto Store = dyn_cast<StoreInst>(User);
+            auto Slot = Store ? dyn_cast<AllocaInst>(Store->getPointerOperand()) : nullptr;
+            if (!Slot || Store->getValueOperand() != &Arg
+                || !all_of(Slot->users(), [&](llvm::User *U) { return U == Store || isa<LoadInst>(U); }))
+                continue;
+            for (auto SlotUser: Slot->users())
+                if (auto Load = dyn_cast<LoadInst>(SlotUser))
+                    Copies[Load] = &Arg;
+        }
+    }
+
+    std::map<Argument *, uint64_t> Bytes;
+    for (auto &Inst: Func->getEntryBlock()) {
+        if (auto Ptr = getLoadStorePointerOperand(&Inst)) {
+            auto AccessType = getLoadStoreType(&Inst);
+            // A constant offset from a null pointer is no valid address either
+            auto Base = Copies.find(Ptr);
+            uint64_t Size = 0;
+            if (Base != Copies.end() && (AccessType->isIntegerTy() || AccessType->isFloatingPointTy()))
+                Size = AccessType->getPrimitiveSizeInBits() / 8;
+            if (Base == Copies.end())
+                Base = Copies.find(Ptr->stripInBoundsConstantOffsets());
+            if (Base != Copies.end())
+                Bytes[Base->second] = std::max(Bytes[Base->second], Size);
+        }
+        if (!isGuaranteedToTransferExecutionToSuccessor(&Inst))
+            break;
+    }
 
-        if (Result != Scope->Allocas.end()) {
-            *AllocaPtr = Result->second;
-            return true;
-        } else
-            Scope = Scope->Parent;
+    for (auto [Arg, Size]: Bytes) {
+        Arg->addAttr(Attribute::NonNull);
+        if (Size)
+            Arg->addAttr(Attribute::getWithDereferenceableBytes(Func->getContext(), Size));
     }
-    return false;
 }
 
-bool Gen::TryPutPointer(Value *PtrVal, Type *Pointee, size_t Depth) {
-    GPointer Value{};
-
-    Value.PointeeType = Pointee;
-    Value.Depth = Depth;
+void Gen::InferAttributes(Function *Func) {
+    InferMemoryEffects(Func);
+    InferDereferenceable(Func);
+}
 
-    return CurScope->Pointers.try_emplace(PtrVal, Value).second;
+bool Gen::TryPutValue(StringRef Name, GVariable *Var) {
+    return Symbols.TryPut(Name, Var);
 }
 
-bool Gen::TryGetPointer(Value *PtrVal, Type **Pointee, size_t *Depth) {
-    GScope *Scope = CurScope;
-    while (Scope) {
-        auto Result = Scope->Pointers.find(PtrVal);
+bool Gen::TryGetValue(StringRef Name, GVariable **VarPtr) {
+    return Symbols.TryGet(Name, VarPtr);
+}
 
-        if (Result != Scope->Pointers.end()) {
-            *Pointee = Result->second.PointeeType;
-            *Depth = Result->second.Depth;
-            return true;
-        } else
-            Scope = Scope->Parent;
+Type *Gen::GetType(CType *Type) {
+    switch (Type->TypeKind) {
+        case CType::VOID:
+            return TVoid;
+        case CType::INT:
+            return IntegerType::get(*Context, Type->Size * 8);
+        case CType::FLOAT:
+            return Type->Size == 4 ? TFloat32 : TFloat64;
+        case CType::POINTER:
+            return TPtr;
+        case CType::ARRAY:
+            // A variable length array is addressed through its element type
+            if (Type->IsVLA)
+                return GetType(Type->Base);
+            return ArrayType::get(GetType(Type->Base), Type->Count);
+        default: {
+            auto &StrType = Structs[Type];
+            if (!StrType) {
+                StrType = StructType::create(*Context, Type->Name);
+                std::vector<llvm::Type *> FieldTypes;
+                for (auto FieldType: Type->FieldTypes)
+                    FieldTypes.push_back(GetType(FieldType));
+                StrType->setBody(FieldTypes);
+            }
+            return StrType;
+        }
     }
-    return false;
 }
 
-bool Gen::TryPutType(std::string Name, Type *Type) {
-    return Types.try_emplace(Name, Type).second;
+Value *Gen::CastTo(Value *Val, CType *From, CType *To) {
+    if (From == To || To->IsVoid())
+        return Val;
+
+    auto DestType = GetType(To);
+    if (From->IsInteger()) {
+        if (To->IsInteger())
+            return Builder->CreateIntCast(Val, DestType, From->IsSigned);
+        if (To->IsFloat())
+            return From->IsSigned ? Builder->CreateSIToFP(Val, DestType) : Builder->CreateUIToFP(Val, DestType);
+        if (To->IsPointer())
+            return Builder->CreateIntToPtr(Builder->CreateIntCast(Val, TInt64, From->IsSigned), DestType);
+    } else if (From->IsFloat()) {
+        if (To->IsFloat())
+            return Builder->CreateFPCast(Val, DestType);
+        if (To->IsInteger())
+            return To->IsSigned ? Builder->CreateFPToSI(Val, DestType) : Builder->CreateFPToUI(Val, DestType);
+    } else if (From->IsPointer() && To->IsInteger())
+        return Builder->CreatePtrToInt(Val, DestType);
+
+    // Pointers share one type, structs are only copied between equal types
+    return Val;
 }
 
-bool Gen::TryGetType(std::string Name, Type **TypePtr) {
-    {
-        auto Result = Types.find(Name);
+static void CollectAddressTaken(PNode *Node, std::set<std::string> &Names) {
+    if (auto Ref = dynamic_cast<RefNode *>(Node))
+        if (auto Ident = dynamic_cast<IdentifierNode *>(Ref->Expr); Ident && !Ref->IsDeref)
+            Names.insert(Ident->Name);
 
-        if (Result != Types.end()) {
+    for (auto Child: Node->GetChildren())
+        CollectAddressTaken(Child, Names);
+}
 
-            *TypePtr = Result->second;
-            return true;
+void Gen::BeginFunction(Function *Func, PrototypeNode *Proto) {
+    // Variables are looked up by name, so a shadowed name that has its address
+    // taken anywhere in the function keeps all of its variables on the stack
+    if (DirectSSA)
+        CollectAddressTaken(Proto->BodyExpr, AddressTaken);
+
+    if (DebugBuilder) {
+        // Line tables leave out the types, like the variables
+        std::vector<Metadata *> Signature;
+        if (DebugInfo == DebugInfoKind::FULL) {
+            Signature.push_back(GetDebugType(Proto->Type));
+            for (auto Param: Proto->Params)
+                Signature.push_back(GetDebugType(Param->Type));
         }
+        auto SubroutineType = DebugBuilder->createSubroutineType(DebugBuilder->getOrCreateTypeArray(Signature));
+        Subprogram = DebugBuilder->createFunction(DebugFile, Proto->Name, StringRef(), DebugFile, Proto->Row + 1,
+                                                  SubroutineType, Proto->Row + 1, DINode::FlagPrototyped,
+                                                  DISubprogram::SPFlagDefinition);
+        Func->setSubprogram(Subprogram);
+    }
+
+    // Code generation reads the relaxed floating point model from the function
+    if (FastMath)
+        for (auto Attr: {"unsafe-fp-math", "no-nans-fp-math", "no-infs-fp-math", "no-signed-zeros-fp-math"})
+            Func->addFnAttr(Attr, "true");
+
+    auto Entry = BasicBlock::Create(*Context, "entry", Func);
+    Builder->SetInsertPoint(Entry);
+    SealBlock(Entry);
+}
+
+void Gen::EndFunction() {
+    if (Subprogram)
+        DebugBuilder->finalizeSubprogram(Subprogram);
+    Subprogram = nullptr;
+    Builder->SetCurrentDebugLocation(DebugLoc());
+
+    Builder->ClearInsertionPoint();
+    CurrentDefs.clear();
+    IncompletePhis.clear();
+    SealedBlocks.clear();
+    AddressTaken.clear();
+}
+
+GVariable *Gen::CreateVariable(const std::string &Name, CType *DeclType, Value *ArraySize) {
+    // Variables outlive their scope, phis may still be completed for them
+    auto Var = new GVariable{Name, DeclType, GetType(DeclType), nullptr, false, nullptr};
+    Variables.emplace_back(Var);
+
+    if (IsFileScope()) {
+        auto Init = ShouldDefine(Name) ? Constant::getNullValue(Var->VarType) : nullptr;
+        Var->Address = new GlobalVariable(*MainModule, Var->VarType, false, GlobalValue::ExternalLinkage, Init, Name);
+        return Var;
     }
 
-    GScope *Scope = CurScope;
-    while (Scope) {
-        auto result = Scope->Structs.find(Name);
+    Var->IsVLA = ArraySize != nullptr;
+
+    bool Promoted = DirectSSA && !ArraySize && (Var->VarType->isIntegerTy() || Var->VarType->isFloatingPointTy())
+                    && !AddressTaken.count(Name);
+    if (!Promoted)
+        Var->Address = CreateEntryAlloca(Var->VarType, ArraySize, Name);
+    return Var;
+}
 
-        if (result != Scope->Structs.end()) {
-            *TypePtr = result->second->StrType;
-            return true;
-        } else
-            Scope = Scope->Parent;
+AllocaInst *Gen::CreateEntryAlloca(Type *AllocaType, Value *ArraySize, const std::string &Name) {
+    // A variable length array is sized where it is declared
+    if (ArraySize) {
+        auto &Scope = Scopes.back();
+        if (!Scope.StackSave)
+            Scope.StackSave = Builder->CreateCall(Intrinsic::getDeclaration(MainModule, Intrinsic::stacksave));
+        return Builder->CreateAlloca(AllocaType, ArraySize, Name);
     }
-    return false;
+
+    // Fixed slots go to the entry block, so a declaration inside a loop does not
+    // grow the stack on every iteration and mem2reg can promote the slot
+    auto &Entry = Builder->GetInsertBlock()->getParent()->getEntryBlock();
+    auto InsertPoint = Entry.begin();
+    while (InsertPoint != Entry.end() && isa<AllocaInst>(*InsertPoint))
+        InsertPoint++;
+
+    IRBuilder<> EntryBuilder(&Entry, InsertPoint);
+    return EntryBuilder.CreateAlloca(AllocaType, ArraySize, Name);
 }
 
-Value *IdentifierNode::Emit(Gen *G) {
-    AllocaInst *Alloca;
-    if (!G->TryGetValue(Name, &Alloca))
-        return G->ThrowError(this, "unknown variable name `" + Name + "`");
+Value *Gen::CreateElementAddress(GVariable *Var, PNode *IndexExpr, Type **ElementType) {
+    // Indices are widened to the pointer width up front, so scalar evolution
+    // sees one sign extension of the induction variable rather than the
+    // implicit one inside each GEP
+    auto Index = Builder->CreateIntCast(IndexExpr->Emit(this), TInt64, IndexExpr->Type->IsSigned);
+
+    if (auto ArrType = dyn_cast<ArrayType>(Var->VarType)) {
+        *ElementType = ArrType->getElementType();
+        return Builder->CreateInBoundsGEP(ArrType, Var->Address, {ConstantInt::get(TInt64, 0), Index});
+    }
+
+    if (Var->IsVLA) {
+        *ElementType = Var->VarType;
+        return Builder->CreateInBoundsGEP(Var->VarType, Var->Address, Index);
+    }
+
+    *ElementType = GetType(Var->DeclType->Base);
+    return Builder->CreateInBoundsGEP(*ElementType, LoadVariable(Var), Index);
+}
+
+Value *Gen::EmitInitList(GVariable *Var, InitListNode *List) {
+    auto ArrType = cast<ArrayType>(Var->VarType);
+    auto ElementCType = Var->DeclType->Base;
+
+    std::vector<Value *> Elements;
+    std::vector<Constant *> Inits;
+    for (auto Element: List->Elements) {
+        Elements.push_back(CastTo(Element->Emit(this), Element->Type, ElementCType));
+        if (auto Init = dyn_cast<Constant>(Elements.back()))
+            Inits.push_back(Init);
+    }
 
-    if (Alloca->isArrayAllocation()) {
-        auto ElType = Alloca->getAllocatedType();
+    bool IsConstant = Inits.size() == Elements.size();
+    if (IsConstant)
+        Inits.resize(ArrType->getNumElements(), Constant::getNullValue(ArrType->getElementType()));
+
+    if (IsFileScope()) {
+        auto Global = cast<GlobalVariable>(Var->Address);
+        if (!IsConstant)
+            return ThrowError(List, "initializer element is not a compile-time constant");
+        if (!Global->isDeclaration())
+            Global->setInitializer(ConstantArray::get(ArrType, Inits));
+        return Global;
+    }
+
+    // A constant table is copied from .rodata, which lets the optimizer read
+    // the table directly when the copy is never written
+    auto Size = ConstantExpr::getSizeOf(ArrType);
+    if (IsConstant) {
+        auto Table = new GlobalVariable(*MainModule, ArrType, true, GlobalValue::PrivateLinkage,
+                                        ConstantArray::get(ArrType, Inits), Var->Name + ".init");
+        Table->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+        Builder->CreateMemCpy(Var->Address, MaybeAlign(), Table, MaybeAlign(), Size);
+        return Var->Address;
+    }
+
+    if (Elements.size() < ArrType->getNumElements())
+        Builder->CreateMemSet(Var->Address, Builder->getInt8(0), Size, MaybeAlign());
+    for (size_t i = 0; i < Elements.size(); i++)
+        Builder->CreateStore(Elements[i], Builder->CreateConstInBoundsGEP2_64(ArrType, Var->Address, 0, i));
+    return Var->Address;
+}
+
+Value *Gen::LoadVariable(GVariable *Var) {
+    if (Var->Address)
+        return Builder->CreateLoad(Var->VarType, Var->Address, Var->Name);
+    return ReadVariable(Var, Builder->GetInsertBlock());
+}
+
+void Gen::StoreVariable(GVariable *Var, Value *Val) {
+    if (Var->Address) {
+        Builder->CreateStore(Val, Var->Address);
+        return;
+    }
 
-        if (IndexExpr) {
-            auto Index = IndexExpr->Emit(G);
-            auto El = G->Builder->CreateGEP(ElType, Alloca, Index);
-            return G->Builder->CreateLoad(ElType, El, Name);
-        } else {
-            return G->Builder->CreateConstGEP1_32(ElType, Alloca, 0);
+    WriteVariable(Var, Builder->GetInsertBlock(), Val);
+    // A variable without a slot is described by each value it takes
+    if (Var->DebugVar) {
+        auto Location = DILocation::get(*Context, Var->DebugVar->getLine(), 0, Var->DebugVar->getScope());
+        DebugBuilder->insertDbgValueIntrinsic(Val, Var->DebugVar, DebugBuilder->createExpression(), Location,
+                                              Builder->GetInsertBlock());
+    }
+}
+
+bool Gen::IsTerminated() const {
+    auto Block = Builder->GetInsertBlock();
+    return Block && Block->getTerminator();
+}
+
+bool Gen::IsFileScope() const {
+    return !Builder->GetInsertBlock();
+}
+
+DebugLoc Gen::GetLocation(PNode *Node) const {
+    if (!Subprogram)
+        return DebugLoc();
+    return DILocation::get(*Context, Node->Row + 1, Node->Column + 1, GetDebugScope());
+}
+
+void Gen::DescribeVariable(GVariable *Var, PNode *Decl, unsigned ArgNo) {
+    if (DebugInfo != DebugInfoKind::FULL)
+        return;
+
+    auto Line = Decl->Row + 1;
+    auto DebugType = GetDebugType(Var->DeclType);
+    if (IsFileScope()) {
+        // Declarations of other units are described where they are defined
+        auto Global = cast<GlobalVariable>(Var->Address);
+        if (!Global->isDeclaration())
+            Global->addDebugInfo(DebugBuilder->createGlobalVariableExpression(CompileUnit, Var->Name, "", DebugFile,
+                                                                            Line, DebugType, false));
+        return;
+    }
+
+    auto Scope = GetDebugScope();
+    if (ArgNo)
+        Var->DebugVar = DebugBuilder->createParameterVariable(Scope, Var->Name, ArgNo, DebugFile, Line, DebugType);
+    else
+        Var->DebugVar = DebugBuilder->createAutoVariable(Scope, Var->Name, DebugFile, Line, DebugType);
+
+    if (Var->Address)
+        DebugBuilder->insertDeclare(Var->Address, Var->DebugVar, DebugBuilder->createExpression(),
+                                    DILocation::get(*Context, Line, Decl->Column + 1, Scope),
+                                    Builder->GetInsertBlock());
+}
+
+DIScope *Gen::GetDebugScope() const {
+    for (auto Scope = Scopes.rbegin(); Scope != Scopes.rend(); Scope++)
+        if (Scope->DebugScope)
+            return Scope->DebugScope;
+    return Subprogram;
+}
+
+// Size and alignment in bytes. The target is not known before the backend
+// runs, so this is the natural alignment of the 64-bit System V ABIs.
+static void GetLayout(CType *Type, uint64_t *Size, uint64_t *Align) {
+    switch (Type->TypeKind) {
+        case CType::VOID:
+            *Size = 0;
+            *Align = 1;
+            return;
+        case CType::INT:
+        case CType::FLOAT:
+            *Size = *Align = Type->Size;
+            return;
+        case CType::POINTER:
+            *Size = *Align = 8;
+            return;
+        case CType::ARRAY:
+            GetLayout(Type->Base, Size, Align);
+            *Size *= Type->IsVLA ? 0 : Type->Count;
+            return;
+        default: {
+            uint64_t Offset = 0, MaxAlign = 1;
+            for (auto FieldType: Type->FieldTypes) {
+                uint64_t FieldSize, FieldAlign;
+                GetLayout(FieldType, &FieldSize, &FieldAlign);
+                Offset = alignTo(Offset, FieldAlign) + FieldSize;
+                MaxAlign = std::max(MaxAlign, FieldAlign);
+            }
+            *Size = alignTo(Offset, MaxAlign);
+            *Align = MaxAlign;
+            return;
+        }
+    }
+}
+
+DIType *Gen::GetDebugType(CType *Type) {
+    auto Cached = DebugTypes.find(Type);
+    if (Cached != DebugTypes.end())
+        return Cached->second;
+
+    uint64_t Size, Align;
+    GetLayout(Type, &Size, &Align);
+
+    DIType *Result = nullptr;
+    switch (Type->TypeKind) {
+        case CType::VOID:
+            break;
+        case CType::INT:
+            Result = DebugBuilder->createBasicType(Type->ToString(), Size * 8,
+                                                   Size == 1 ? dwarf::DW_ATE_signed_char : dwarf::DW_ATE_signed);
+            break;
+        case CType::FLOAT:
+            Result = DebugBuilder->createBasicType(Type->ToString(), Size * 8, dwarf::DW_ATE_float);
+            break;
+        case CType::POINTER:
+            Result = DebugBuilder->createPointerType(GetDebugType(Type->Base), Size * 8);
+            break;
+        case CType::ARRAY: {
+            // A variable length array has no count to describe
+            auto Subrange = DebugBuilder->getOrCreateSubrange(0, Type->IsVLA ? -1 : (int64_t) Type->Count);
+            Result = DebugBuilder->createArrayType(Size * 8, Align * 8, GetDebugType(Type->Base),
+                                                   DebugBuilder->getOrCreateArray({Subrange}));
+            break;
         }
+        default: {
+            // The struct is cached before its fields, which may point back to it
+            auto Struct = DebugBuilder->createStructType(CompileUnit, Type->Name, DebugFile, 0, Size * 8, Align * 8,
+                                                         DINode::FlagZero, nullptr,
+                                                         DebugBuilder->getOrCreateArray({}));
+            DebugTypes[Type] = Struct;
+
+            std::vector<Metadata *> Members;
+            uint64_t Offset = 0;
+            for (size_t i = 0; i < Type->FieldTypes.size(); i++) {
+                uint64_t FieldSize, FieldAlign;
+                GetLayout(Type->FieldTypes[i], &FieldSize, &FieldAlign);
+                Offset = alignTo(Offset, FieldAlign);
+                Members.push_back(DebugBuilder->createMemberType(Struct, Type->FieldNames[i], DebugFile, 0,
+                                                                 FieldSize * 8, FieldAlign * 8, Offset * 8,
+                                                                 DINode::FlagZero,
+                                                                 GetDebugType(Type->FieldTypes[i])));
+                Offset += FieldSize;
+            }
+            DebugBuilder->replaceArrays(Struct, DebugBuilder->getOrCreateArray(Members));
+            return Struct;
+        }
+    }
+    return DebugTypes[Type] = Result;
+}
+
+GLocation::GLocation(Gen *G, PNode *Node) : G(G), Saved(G->Builder->getCurrentDebugLocation()) {
+    G->Builder->SetCurrentDebugLocation(G->GetLocation(Node));
+}
+
+GLocation::~GLocation() {
+    G->Builder->SetCurrentDebugLocation(Saved);
+}
+
+Value *Gen::EmitCondition(PNode *Expr) {
+    auto Val = Expr->Emit(this);
+    // Comparisons widen their result to an int, a condition only needs the bit
+    // The widened value is left for dead code elimination, under -fssa it may
+    // be the current value of a variable without having any uses yet
+    if (auto Widened = dyn_cast<ZExtInst>(Val); Widened && Widened->getSrcTy()->isIntegerTy(1))
+        Val = Widened->getOperand(0);
+    if (Val->getType()->isIntegerTy(1))
+        return Val;
+    if (Val->getType()->isFloatingPointTy())
+        return Builder->CreateFCmpUNE(Val, ConstantFP::get(Val->getType(), 0.0));
+    return Builder->CreateIsNotNull(Val);
+}
+
+// Weights clang gives to __builtin_expect, the unlikely edge is taken
+// once in every two thousand
+static const uint32_t LikelyBranchWeight = 2000;
+static const uint32_t UnlikelyBranchWeight = 1;
+
+void Gen::EmitBranch(PNode *Cond, BasicBlock *TrueBlock, BasicBlock *FalseBlock, int Likelihood) {
+    if (auto Not = dynamic_cast<UnOpNode *>(Cond); Not && Not->OpType == TType::BANG)
+        return EmitBranch(Not->Expr, FalseBlock, TrueBlock, -Likelihood);
+
+    // The expected value decides the direction, an expression that is not
+    // constant gives no hint
+    if (auto Call = dynamic_cast<CallNode *>(Cond); Call && Call->IsBuiltinExpect()) {
+        if (auto Expected = dynamic_cast<IntegerNode *>(Call->ArgExprs[1]))
+            Likelihood = Expected->Value ? 1 : -1;
+        else
+            Call->ArgExprs[1]->Emit(this);
+        return EmitBranch(Call->ArgExprs[0], TrueBlock, FalseBlock, Likelihood);
+    }
+
+    auto Logical = dynamic_cast<BinOpNode *>(Cond);
+    if (!Logical || (Logical->OpType != TType::AND && Logical->OpType != TType::OR)) {
+        MDNode *Weights = nullptr;
+        if (Likelihood)
+            Weights = MDBuilder(*Context).createBranchWeights(Likelihood > 0 ? LikelyBranchWeight : UnlikelyBranchWeight,
+                                                              Likelihood > 0 ? UnlikelyBranchWeight : LikelyBranchWeight);
+        Builder->CreateCondBr(EmitCondition(Cond), TrueBlock, FalseBlock, Weights);
+        return;
+    }
+
+    // The right operand is only reached when the left one does not decide the
+    // result. Each operand of a likely && is likely true and each one of an
+    // unlikely || is likely false, the other cases say nothing about a single one.
+    bool IsAnd = Logical->OpType == TType::AND;
+    int OperandLikelihood = (IsAnd && Likelihood > 0) || (!IsAnd && Likelihood < 0) ? Likelihood : 0;
+    auto Func = Builder->GetInsertBlock()->getParent();
+    auto RHSBlock = BasicBlock::Create(*Context, "rhs");
+    EmitBranch(Logical->LHS, IsAnd ? RHSBlock : TrueBlock, IsAnd ? FalseBlock : RHSBlock, OperandLikelihood);
+    SealBlock(RHSBlock);
+
+    Func->getBasicBlockList().push_back(RHSBlock);
+    Builder->SetInsertPoint(RHSBlock);
+    EmitBranch(Logical->RHS, TrueBlock, FalseBlock, OperandLikelihood);
+}
+
+void Gen::WriteVariable(GVariable *Var, BasicBlock *Block, Value *Val) {
+    CurrentDefs[Block][Var] = Val;
+}
+
+Value *Gen::ReadVariable(GVariable *Var, BasicBlock *Block) {
+    auto &Defs = CurrentDefs[Block];
+    auto Result = Defs.find(Var);
+    if (Result != Defs.end() && Result->second)
+        return Result->second;
+    return ReadVariableRecursive(Var, Block);
+}
+
+Value *Gen::ReadVariableRecursive(GVariable *Var, BasicBlock *Block) {
+    Value *Val;
+    if (!SealedBlocks.count(Block)) {
+        // Operands are added once all predecessors are known
+        auto Phi = CreatePhi(Var, Block);
+        IncompletePhis[Block][Var] = Phi;
+        Val = Phi;
+    } else if (auto Pred = Block->getSinglePredecessor()) {
+        Val = ReadVariable(Var, Pred);
+    } else if (pred_empty(Block)) {
+        // Read before any assignment, or in unreachable code
+        Val = UndefValue::get(Var->VarType);
     } else {
-        return G->Builder->CreateLoad(Alloca->getAllocatedType(), Alloca, Name);
+        // The phi is recorded first to break cycles through loops
+        auto Phi = CreatePhi(Var, Block);
+        WriteVariable(Var, Block, Phi);
+        Val = AddPhiOperands(Var, Phi);
+    }
+    WriteVariable(Var, Block, Val);
+    return Val;
+}
+
+PHINode *Gen::CreatePhi(GVariable *Var, BasicBlock *Block) {
+    if (Block->empty())
+        return PHINode::Create(Var->VarType, 0, Var->Name, Block);
+    return PHINode::Create(Var->VarType, 0, Var->Name, &Block->front());
+}
+
+Value *Gen::AddPhiOperands(GVariable *Var, PHINode *Phi) {
+    auto Block = Phi->getParent();
+    for (auto Pred: predecessors(Block))
+        Phi->addIncoming(ReadVariable(Var, Pred), Pred);
+    return TryRemoveTrivialPhi(Phi);
+}
+
+Value *Gen::TryRemoveTrivialPhi(PHINode *Phi) {
+    Value *Same = nullptr;
+    for (auto &Op: Phi->incoming_values()) {
+        if (Op == Same || Op == Phi)
+            continue;
+        if (Same)
+            return Phi;
+        Same = Op;
     }
+    if (!Same)
+        Same = UndefValue::get(Phi->getType());
+
+    std::vector<WeakTrackingVH> Users;
+    for (auto User: Phi->users())
+        if (User != Phi && isa<PHINode>(User))
+            Users.emplace_back(User);
+
+    // The value handles in CurrentDefs follow the replacement
+    Phi->replaceAllUsesWith(Same);
+    Phi->eraseFromParent();
+
+    // Same may itself be a phi that turns trivial below
+    WeakTrackingVH Result(Same);
+    for (auto &User: Users)
+        if (auto UserPhi = dyn_cast_or_null<PHINode>(User))
+            TryRemoveTrivialPhi(UserPhi);
+    return Result;
+}
+
+void Gen::SealBlock(BasicBlock *Block) {
+    auto Incomplete = IncompletePhis.find(Block);
+    if (Incomplete != IncompletePhis.end()) {
+        auto Phis = std::move(Incomplete->second);
+        IncompletePhis.erase(Incomplete);
+        // Removing a trivial phi may have erased one of the others
+        for (auto &[Var, Phi]: Phis)
+            if (auto IncompletePhi = dyn_cast_or_null<PHINode>(Phi))
+                AddPhiOperands(Var, IncompletePhi);
+    }
+    SealedBlocks.insert(Block);
+}
+
+Value *IdentifierNode::Emit(Gen *G) {
+    GLocation Location(G, this);
+    GVariable *Var;
+    if (!G->TryGetValue(Name, &Var))
+        return G->ThrowError(this, "unknown variable name `" + Name + "`");
+
+    if (IndexExpr) {
+        llvm::Type *ElType;
+        auto El = G->CreateElementAddress(Var, IndexExpr, &ElType);
+        return G->Builder->CreateLoad(ElType, El, Name);
+    }
+
+    // Arrays decay to a pointer to their first element
+    if (Var->VarType->isArrayTy())
+        return G->Builder->CreateConstInBoundsGEP2_32(Var->VarType, Var->Address, 0, 0);
+    if (Var->IsVLA)
+        return Var->Address;
+    return G->LoadVariable(Var);
 }
 
 Value *IntegerNode::Emit(Gen *G) {
@@ -181,50 +784,163 @@ Value *IntegerNode::Emit(Gen *G) {
 }
 
 Value *FloatNode::Emit(Gen *G) {
-    return nullptr;
+    return ConstantFP::get(G->GetType(Type), Value);
 }
 
 Value *StringNode::Emit(Gen *G) {
-    return G->Builder->CreateGlobalStringPtr(Text);
+    // File-scope initializers have no insertion point to take the module from
+    return G->Builder->CreateGlobalStringPtr(Text, "", 0, G->MainModule);
 }
 
 Value *BinOpNode::Emit(Gen *G) {
+    GLocation Location(G, this);
+    if (OpType == TType::AND || OpType == TType::OR) {
+        // Every edge that skips the right operand carries the deciding value
+        bool IsAnd = OpType == TType::AND;
+        auto Func = G->Builder->GetInsertBlock()->getParent();
+        auto RHSBlock = BasicBlock::Create(*G->Context, "rhs");
+        auto MergeBlock = BasicBlock::Create(*G->Context, "logic");
+
+        G->EmitBranch(LHS, IsAnd ? RHSBlock : MergeBlock, IsAnd ? MergeBlock : RHSBlock);
+        G->SealBlock(RHSBlock);
+
+        Func->getBasicBlockList().push_back(RHSBlock);
+        G->Builder->SetInsertPoint(RHSBlock);
+        auto R = G->EmitCondition(RHS);
+        auto RHSEnd = G->Builder->GetInsertBlock();
+        G->Builder->CreateBr(MergeBlock);
+
+        Func->getBasicBlockList().push_back(MergeBlock);
+        G->Builder->SetInsertPoint(MergeBlock);
+        G->SealBlock(MergeBlock);
+
+        auto Phi = G->Builder->CreatePHI(R->getType(), 2);
+        for (auto Pred: predecessors(MergeBlock))
+            Phi->addIncoming(Pred == RHSEnd ? R : ConstantInt::getBool(*G->Context, !IsAnd), Pred);
+        return G->Builder->CreateZExt(Phi, G->GetType(Type));
+    }
+
+    // Operands are emitted left to right before the operation is picked
+    auto L = LHS->Emit(G);
+    auto R = RHS->Emit(G);
+
+    if (OperandType->IsPointer()) {
+        auto ElementType = G->GetType(OperandType->Base);
+        if (OpType == TType::MINUS && LHS->Type->IsPointer() && RHS->Type->IsPointer())
+            return G->Builder->CreatePtrDiff(ElementType, L, R);
+
+        if (OpType == TType::PLUS || OpType == TType::MINUS) {
+            auto Ptr = LHS->Type->IsPointer() ? L : R;
+            auto Offset = LHS->Type->IsPointer() ? RHS : LHS;
+            auto OffsetVal = G->Builder->CreateIntCast(Ptr == L ? R : L, G->TInt64, Offset->Type->IsSigned);
+            if (OpType == TType::MINUS)
+                OffsetVal = G->Builder->CreateNSWNeg(OffsetVal);
+            return G->Builder->CreateInBoundsGEP(ElementType, Ptr, OffsetVal);
+        }
+    }
+
+    L = G->CastTo(L, LHS->Type, OperandType);
+    R = G->CastTo(R, RHS->Type, OperandType);
+
+    if (OperandType->IsFloat()) {
+        // Ordered comparisons are false for a NaN operand, != is true for it
+        Value *FCmp;
+        switch (OpType) {
+            case TType::PLUS:
+                return G->Builder->CreateFAdd(L, R);
+            case TType::MINUS:
+                return G->Builder->CreateFSub(L, R);
+            case TType::STAR:
+                return G->Builder->CreateFMul(L, R);
+            case TType::SLASH:
+                return G->Builder->CreateFDiv(L, R);
+            case TType::GREAT_EQ:
+                FCmp = G->Builder->CreateFCmpOGE(L, R);
+                break;
+            case TType::GREAT:
+                FCmp = G->Builder->CreateFCmpOGT(L, R);
+                break;
+            case TType::D_EQUAL:
+                FCmp = G->Builder->CreateFCmpOEQ(L, R);
+                break;
+            case TType::BANG_EQ:
+                FCmp = G->Builder->CreateFCmpUNE(L, R);
+                break;
+            case TType::LESS:
+                FCmp = G->Builder->CreateFCmpOLT(L, R);
+                break;
+            case TType::LESS_EQ:
+                FCmp = G->Builder->CreateFCmpOLE(L, R);
+                break;
+            default:
+                return G->ThrowError(this, "unsupported binary operator " + Token::GetName(OpType));
+        }
+        return G->Builder->CreateZExt(FCmp, G->GetType(Type));
+    }
+
+    // Pointers compare as unsigned addresses
+    bool Signed = OperandType->IsSigned;
+
+    // Signed overflow is undefined, which lets scalar evolution compute trip counts
+    Value *Cmp;
     switch (OpType) {
         case TType::PLUS:
-            return G->Builder->CreateAdd(LHS->Emit(G), RHS->Emit(G));
+            return G->Builder->CreateNSWAdd(L, R);
         case TType::MINUS:
-            return G->Builder->CreateSub(LHS->Emit(G), RHS->Emit(G));
+            return G->Builder->CreateNSWSub(L, R);
         case TType::STAR:
-            return G->Builder->CreateMul(LHS->Emit(G), RHS->Emit(G));
+            return G->Builder->CreateNSWMul(L, R);
         case TType::SLASH:
-            return G->Builder->CreateSDiv(LHS->Emit(G), RHS->Emit(G));
+            return G->Builder->CreateSDiv(L, R);
+        case TType::PERCENT:
+            return G->Builder->CreateSRem(L, R);
         case TType::BIN_OR:
-            return G->Builder->CreateOr(LHS->Emit(G), RHS->Emit(G));
+            return G->Builder->CreateOr(L, R);
         case TType::BIN_AND:
-            return G->Builder->CreateAnd(LHS->Emit(G), RHS->Emit(G));
+            return G->Builder->CreateAnd(L, R);
         case TType::GREAT_EQ:
-            return G->Builder->CreateICmpSGE(LHS->Emit(G), RHS->Emit(G));
+            Cmp = Signed ? G->Builder->CreateICmpSGE(L, R) : G->Builder->CreateICmpUGE(L, R);
+            break;
         case TType::GREAT:
-            return G->Builder->CreateICmpSGT(LHS->Emit(G), RHS->Emit(G));
+            Cmp = Signed ? G->Builder->CreateICmpSGT(L, R) : G->Builder->CreateICmpUGT(L, R);
+            break;
         case TType::D_EQUAL:
-            return G->Builder->CreateICmpEQ(LHS->Emit(G), RHS->Emit(G));
+            Cmp = G->Builder->CreateICmpEQ(L, R);
+            break;
         case TType::BANG_EQ:
-            return G->Builder->CreateICmpNE(LHS->Emit(G), RHS->Emit(G));
+            Cmp = G->Builder->CreateICmpNE(L, R);
+            break;
         case TType::LESS:
-            return G->Builder->CreateICmpSLT(LHS->Emit(G), RHS->Emit(G));
+            Cmp = Signed ? G->Builder->CreateICmpSLT(L, R) : G->Builder->CreateICmpULT(L, R);
+            break;
         case TType::LESS_EQ:
-            return G->Builder->CreateICmpSLE(LHS->Emit(G), RHS->Emit(G));
+            Cmp = Signed ? G->Builder->CreateICmpSLE(L, R) : G->Builder->CreateICmpULE(L, R);
+            break;
         default:
-            return nullptr;
+            return G->ThrowError(this, "unsupported binary operator " + Token::GetName(OpType));
     }
+    // Comparisons produce an int in C
+    return G->Builder->CreateZExt(Cmp, G->GetType(Type));
 }
 
-Value *UnOpNode::Emit(Gen *gen) {
-    return nullptr;
+Value *UnOpNode::Emit(Gen *G) {
+    GLocation Location(G, this);
+    auto Val = Expr->Emit(G);
+    if (Expr->Type->IsFloat()) {
+        if (OpType == TType::BANG)
+            return G->Builder->CreateZExt(G->Builder->CreateFCmpOEQ(Val, ConstantFP::get(Val->getType(), 0.0)),
+                                          G->GetType(Type));
+        return G->Builder->CreateFNeg(Val);
+    }
+
+    if (OpType == TType::BANG)
+        return G->Builder->CreateZExt(G->Builder->CreateIsNull(Val), G->GetType(Type));
+    return G->Builder->CreateNSWNeg(G->CastTo(Val, Expr->Type, Type));
 }
 
 Value *AssignNode::Emit(Gen *G) {
-    AllocaInst *Alloca;
+    GLocation Location(G, this);
+    GVariable *Var;
     std::string AllocaName;
 
     if (Alloc) {
@@ -236,124 +952,103 @@ Value *AssignNode::Emit(Gen *G) {
         AllocaName = Ident->Name;
     }
 
-    if (!G->TryGetValue(AllocaName, &Alloca))
+    if (!G->TryGetValue(AllocaName, &Var))
         return G->ThrowError(this, "unknown variable name");
 
-    auto ExprValue = Expr->Emit(G);
+    if (auto List = dynamic_cast<InitListNode *>(Expr))
+        return G->EmitInitList(Var, List);
 
-    if (Ident && Ident->IndexExpr) {
-
-        auto PtrType = dyn_cast<PointerType>(Alloca->getAllocatedType());
-
-        if (!PtrType && !Alloca->isArrayAllocation())
-            G->ThrowError(this, "indexee must be array or a pointer");
+    auto ExprValue = G->CastTo(Expr->Emit(G), Expr->Type, Type);
 
-        auto Index = Ident->IndexExpr->Emit(G);
+    if (G->IsFileScope()) {
+        auto Global = dyn_cast<GlobalVariable>(Var->Address);
+        auto Init = dyn_cast<Constant>(ExprValue);
+        if (!Global || !Init || (Ident && Ident->IndexExpr))
+            return G->ThrowError(this, "initializer element is not a compile-time constant");
 
-        Value *El = nullptr;
-
-        if (PtrType) {
-            Type *Pointee;
-            size_t Depth;
-            if (!G->TryGetPointer(Alloca, &Pointee, &Depth))
-                G->ThrowError(this, "cant find pointer");
-            auto Type = Depth > 1 ? G->TPtr : Pointee;
-            El = G->Builder->CreateGEP(Type, Alloca, Index);
-        } else {
-            El = G->Builder->CreateGEP(Alloca->getAllocatedType(), Alloca, Index);
-        }
+        if (!Global->isDeclaration())
+            Global->setInitializer(Init);
+        return ExprValue;
+    }
 
+    if (Ident && Ident->IndexExpr) {
+        llvm::Type *ElType;
+        auto El = G->CreateElementAddress(Var, Ident->IndexExpr, &ElType);
         G->Builder->CreateStore(ExprValue, El);
     } else {
-        G->Builder->CreateStore(ExprValue, Alloca);
+        G->StoreVariable(Var, ExprValue);
     }
 
     return ExprValue;
 }
 
+Value *InitListNode::Emit(Gen *G) {
+    return G->ThrowError(this, "initializer list outside of a declaration");
+}
+
 Value *RefNode::Emit(Gen *G) {
-    auto Ident = dynamic_cast<IdentifierNode *>(Expr);
+    GLocation Location(G, this);
     if (IsDeref) {
-        auto EmitVal = Expr->Emit(G);
-        auto PtrVal = getPointerOperand(EmitVal);
-
-        Type *Pointee;
-        size_t Depth;
-        if (!G->TryGetPointer(PtrVal, &Pointee, &Depth))
-            return G->ThrowError(Expr, "cant find pointer");
-
-        auto Type = Depth > 1 ? G->TPtr : Pointee;
-
-        auto LoadVal = EmitVal;
-        for (int i = 0; i < Depth; i++)
-            LoadVal = G->Builder->CreateLoad(Type, LoadVal);
-        return LoadVal;
-    } else {
-        if (!Ident)
-            return G->ThrowError(this, "cannot reference not identifier");
+        auto Val = Expr->Emit(G);
+        auto PtrType = Expr->Type;
+        for (int i = 0; i < Depth; i++) {
+            // An array decays to the address it is stored at instead of being loaded
+            auto Pointee = PtrType->Base;
+            if (!Pointee->IsArray())
+                Val = G->Builder->CreateLoad(G->GetType(Pointee), Val);
+            PtrType = Pointee;
+        }
+        return Val;
+    }
 
-        AllocaInst *Alloca;
-        if (!G->TryGetValue(Ident->Name, &Alloca))
-            return G->ThrowError(this, "unknown variable name `" + Ident->Name + "`");
-        return Alloca;
+    auto Ident = dynamic_cast<IdentifierNode *>(Expr);
+    GVariable *Var;
+    if (!G->TryGetValue(Ident->Name, &Var))
+        return G->ThrowError(this, "unknown variable name `" + Ident->Name + "`");
+    if (!Var->Address)
+        return G->ThrowError(this, "cannot take the address of `" + Ident->Name + "`");
+
+    if (Ident->IndexExpr) {
+        llvm::Type *ElType;
+        return G->CreateElementAddress(Var, Ident->IndexExpr, &ElType);
     }
+    return Var->Address;
 }
 
 Value *AllocNode::Emit(Gen *G) {
-    Type *VarType;
-    if (!G->TryGetType(AllocTypeName, &VarType))
-        return G->ThrowError(this, "unknown type");
-
-    auto AllocaType = PtrDepth ? G->TPtr : VarType;
-
-    auto ArraySizeVal = ArraySizeExpr ? ArraySizeExpr->Emit(G) : nullptr;
-    auto Alloca = G->Builder->CreateAlloca(AllocaType, ArraySizeVal, Name);
-
-    if (PtrDepth && !G->TryPutPointer(Alloca, VarType, PtrDepth))
-        return G->ThrowError(this, "pointer already exists");
+    GLocation Location(G, this);
+    // Only a variable length array has a size to compute at run time
+    auto ArraySizeVal = Type->IsArray() && Type->IsVLA ? ArraySizeExpr->Emit(G) : nullptr;
+
+    auto Var = G->CreateVariable(Name, Type, ArraySizeVal);
+    // Constant data goes to .rodata, and only other modules may rely on its address
+    if (G->IsFileScope() && IsConst()) {
+        auto Global = cast<GlobalVariable>(Var->Address);
+        Global->setConstant(true);
+        Global->setUnnamedAddr(GlobalValue::UnnamedAddr::Local);
+    }
 
-    if (!G->TryPutValue(Name, Alloca))
+    if (!G->TryPutValue(Name, Var))
         return G->ThrowError(this, "name already exists");
-    return Alloca;
+    G->DescribeVariable(Var, this, 0);
+    return Var->Address;
 }
 
-Value *StructNode::Emit(Gen *G) {
-    auto StrType = StructType::create(*G->Context, Name);
-
-    std::vector<std::string> VarNames;
-    std::vector<Type *> VarTypes;
-    for (auto Alloc : AllocNodes) {
-        Type *AllocType;
-        if (!G->TryGetType(Alloc->AllocTypeName, &AllocType))
-            return G->ThrowError(this, "unknown type");
-
-        auto AllocaType = Alloc->PtrDepth ? G->TPtr : AllocType;
-
-        VarNames.push_back(Alloc->Name);
-        VarTypes.push_back(AllocaType);
-    }
-
-    StrType->setBody(VarTypes);
-
-    auto Str = new GStruct(VarNames, VarTypes, StrType);
-
-    if (!G->TryPutStruct(Name, Str))
-        return G->ThrowError(this, "struct name already exists");
+Value *StructNode::Emit(Gen *) {
+    // Struct types are created when a declaration first uses them
+    return nullptr;
 }
 
-Value *TypedefNode::Emit(Gen *G) {
-    Type *DefType;
-
-    if (!G->TryGetType(Alloc->AllocTypeName, &DefType))
-        return G->ThrowError(this, "unknown type");
-
-    if (!G->TryPutType(Alloc->Name, DefType))
-        return G->ThrowError(this, "type exists");
+Value *TypedefNode::Emit(Gen *) {
+    return nullptr;
 }
 
 Value *BlockNode::Emit(Gen *G) {
-    G->PushScope();
+    G->PushScope(this);
     for (auto Node: Nodes) {
+        // Statements after a return are unreachable
+        if (G->IsTerminated())
+            break;
         Node->Emit(G);
     }
     G->PopScope();
@@ -361,24 +1056,24 @@ Value *BlockNode::Emit(Gen *G) {
 }
 
 Value *IfNode::Emit(Gen *G) {
-    Value *CondVal = CondExpr->Emit(G);
-    if (!CondVal)
-        return nullptr;
-    Value *CondValAsBit = G->Builder->CreateIntCast(CondVal, Type::getInt1Ty(*G->Context), false);
-
+    GLocation Location(G, this);
     Function *Func = G->Builder->GetInsertBlock()->getParent();
 
-    BasicBlock *ThenBlock = BasicBlock::Create(*G->Context, "then", Func);
+    BasicBlock *ThenBlock = BasicBlock::Create(*G->Context, "then");
     BasicBlock *ElseBlock = BasicBlock::Create(*G->Context, "else");
     BasicBlock *MergeBlock = BasicBlock::Create(*G->Context, "finally");
 
-    G->Builder->CreateCondBr(CondValAsBit, ThenBlock, ElseBlock);
+    G->EmitBranch(CondExpr, ThenBlock, ElseBlock, Likelihood);
+    G->SealBlock(ThenBlock);
+    G->SealBlock(ElseBlock);
 
+    Func->getBasicBlockList().push_back(ThenBlock);
     G->Builder->SetInsertPoint(ThenBlock);
 
     BodyExpr->Emit(G);
 
-    G->Builder->CreateBr(MergeBlock);
+    if (!G->IsTerminated())
+        G->Builder->CreateBr(MergeBlock);
 
     Func->getBasicBlockList().push_back(ElseBlock);
     G->Builder->SetInsertPoint(ElseBlock);
@@ -386,16 +1081,52 @@ Value *IfNode::Emit(Gen *G) {
     if (ElseBrExpr)
         ElseBrExpr->Emit(G);
 
-    G->Builder->CreateBr(MergeBlock);
+    if (!G->IsTerminated())
+        G->Builder->CreateBr(MergeBlock);
 
     Func->getBasicBlockList().push_back(MergeBlock);
     G->Builder->SetInsertPoint(MergeBlock);
+    G->SealBlock(MergeBlock);
 
     return nullptr;
 }
 
+// Self-referential llvm.loop node carrying the hints, null without any
+static MDNode *CreateLoopID(LLVMContext &Context, const LoopHints &Hints) {
+    if (Hints.Empty())
+        return nullptr;
+
+    auto Int32 = Type::getInt32Ty(Context);
+    auto Int1 = Type::getInt1Ty(Context);
+    auto Property = [&](StringRef Name, Constant *Value) -> Metadata * {
+        if (!Value)
+            return MDNode::get(Context, MDString::get(Context, Name));
+        return MDNode::get(Context, {MDString::get(Context, Name), ConstantAsMetadata::get(Value)});
+    };
+
+    auto Self = MDNode::getTemporary(Context, None);
+    SmallVector<Metadata *, 4> Ops{Self.get()};
+    if (Hints.UnrollFull)
+        Ops.push_back(Property("llvm.loop.unroll.full", nullptr));
+    else if (Hints.UnrollCount == 1)
+        Ops.push_back(Property("llvm.loop.unroll.disable", nullptr));
+    else if (Hints.UnrollCount)
+        Ops.push_back(Property("llvm.loop.unroll.count", ConstantInt::get(Int32, Hints.UnrollCount)));
+    if (Hints.Vectorize)
+        Ops.push_back(Property("llvm.loop.vectorize.enable", ConstantInt::get(Int1, Hints.Vectorize > 0)));
+    if (Hints.VectorizeWidth)
+        Ops.push_back(Property("llvm.loop.vectorize.width", ConstantInt::get(Int32, Hints.VectorizeWidth)));
+    if (Hints.Distribute)
+        Ops.push_back(Property("llvm.loop.distribute.enable", ConstantInt::getTrue(Context)));
+
+    auto LoopID = MDNode::getDistinct(Context, Ops);
+    LoopID->replaceOperandWith(0, LoopID);
+    return LoopID;
+}
+
 Value *ForNode::Emit(Gen *G) {
-    G->PushScope();
+    GLocation Location(G, this);
+    G->PushScope(this);
 
     if (InitExpr)
         InitExpr->Emit(G);
@@ -409,96 +1140,121 @@ Value *ForNode::Emit(Gen *G) {
     G->Builder->CreateBr(LoopCondBlock);
     G->Builder->SetInsertPoint(LoopCondBlock);
 
-    Value *CondVal = CondExpr ? CondExpr->Emit(G) : ConstantInt::getTrue(*G->Context);
-
-    Value *CondValAsBit = G->Builder->CreateIntCast(CondVal, Type::getInt1Ty(*G->Context), false);
-
-    G->Builder->CreateCondBr(CondValAsBit, LoopBeginBlock, LoopEndBlock);
+    if (CondExpr)
+        G->EmitBranch(CondExpr, LoopBeginBlock, LoopEndBlock);
+    else
+        G->Builder->CreateCondBr(ConstantInt::getTrue(*G->Context), LoopBeginBlock, LoopEndBlock);
+    G->SealBlock(LoopBeginBlock);
+    G->SealBlock(LoopEndBlock);
 
     Func->getBasicBlockList().push_back(LoopBeginBlock);
     G->Builder->SetInsertPoint(LoopBeginBlock);
 
     BodyExpr->Emit(G);
-    if (UpdateExpr)
+    if (UpdateExpr && !G->IsTerminated())
         UpdateExpr->Emit(G);
 
-    G->Builder->CreateBr(LoopCondBlock);
+    // Loop metadata belongs on the latch, the only branch back to the condition
+    if (!G->IsTerminated()) {
+        auto Latch = G->Builder->CreateBr(LoopCondBlock);
+        if (auto LoopID = CreateLoopID(*G->Context, Hints))
+            Latch->setMetadata(LLVMContext::MD_loop, LoopID);
+    }
+
+    // The back edge was the last unknown predecessor of the condition
+    G->SealBlock(LoopCondBlock);
 
     Func->getBasicBlockList().push_back(LoopEndBlock);
     G->Builder->SetInsertPoint(LoopEndBlock);
 
     G->PopScope();
+    return nullptr;
 }
 
 Value *CallNode::Emit(Gen *G) {
-    Function *CalleeFunc = G->MainModule->getFunction(CalleeName);
+    GLocation Location(G, this);
+    if (IsBuiltinExpect()) {
+        // Lowered to branch weights by the optimizer, or dropped at -O0
+        std::vector<Value *> ArgsVals;
+        for (auto ArgExpr: ArgExprs)
+            ArgsVals.push_back(G->CastTo(ArgExpr->Emit(G), ArgExpr->Type, Type));
+        return G->Builder->CreateIntrinsic(Intrinsic::expect, {G->TInt64}, ArgsVals);
+    }
+
+    Function *CalleeFunc = G->MainModule->getFunction(G->GetLinkName(Callee));
     if (!CalleeFunc)
         return G->ThrowError(this, "unknown function referenced");
 
-    if (!CalleeFunc->isVarArg() && CalleeFunc->arg_size() != ArgExprs.size())
-        return G->ThrowError(this, "incorrect # arguments passed");
-
     std::vector<Value *> ArgsVals;
-    for (auto &ArgExpr: ArgExprs) {
-        ArgsVals.push_back(ArgExpr->Emit(G));
-        if (!ArgsVals.back())
+    for (size_t i = 0; i < ArgExprs.size(); i++) {
+        auto ArgType = ArgExprs[i]->Type;
+        auto ArgVal = ArgExprs[i]->Emit(G);
+        if (!ArgVal)
             return nullptr;
+
+        // Fixed arguments take the declared parameter types, variadic ones the default promotions
+        if (i < Callee->Params.size())
+            ArgVal = G->CastTo(ArgVal, ArgType, Callee->Params[i]->Type);
+        else if (ArgType->IsInteger() && ArgType->Size < 4)
+            ArgVal = G->Builder->CreateIntCast(ArgVal, G->TInt32, ArgType->IsSigned);
+        else if (ArgType->IsFloat() && ArgType->Size < 8)
+            ArgVal = G->Builder->CreateFPExt(ArgVal, G->TFloat64);
+        ArgsVals.push_back(ArgVal);
     }
 
-    return G->Builder->CreateCall(CalleeFunc, ArgsVals);
+    auto Call = G->Builder->CreateCall(CalleeFunc, ArgsVals);
+    Call->setCallingConv(CalleeFunc->getCallingConv());
+    return Call;
 }
 
 Value *PrototypeNode::Emit(Gen *G) {
     G->PushScope();
 
-    std::vector<Type *> Types;
-    for (const auto &Param: Params) {
-        Type *ParamType;
-        if (!G->TryGetType(Param->AllocTypeName, &ParamType))
-            return G->ThrowError(this, "unknown type");
-        auto AllocaType = Param->PtrDepth ? G->TPtr : ParamType;
-
-        Types.push_back(AllocaType);
-    }
-
-    Type *ReturnType = nullptr;
+    std::vector<llvm::Type *> Types;
+    for (const auto &Param: Params)
+        Types.push_back(G->GetType(Param->Type));
 
-    if (ReturnAllocNode->PtrDepth)
-        ReturnType = G->TPtr;
-    else if (!G->TryGetType(ReturnAllocNode->AllocTypeName, &ReturnType))
-            return G->ThrowError(this, "unknown type");
+    auto ReturnType = G->GetType(Type);
 
     FunctionType *FuncType = FunctionType::get(ReturnType, Types, IsVarArg);
     Value *Val = nullptr;
-    if (BodyExpr) {
-        auto Func = G->MainModule->getFunction(Name);
-
-        if (!Func)
-            Func = static_cast<llvm::Function *>(G->MainModule->getOrInsertFunction(Name, FuncType).getCallee()); //Function::Create(FuncType, Function::ExternalLinkage, Name, G->MainModule);
-
+    if (BodyExpr && G->ShouldDefine(Name)) {
+        auto Func = G->GetFunction(this, FuncType, true);
         Val = Func;
 
         unsigned Index = 0;
         for (auto &Arg: Func->args())
             Arg.setName(Params[Index++]->Name);
 
-        BasicBlock *BodyBlock = BasicBlock::Create(*G->Context, "entry", Func);
-        G->Builder->SetInsertPoint(BodyBlock);
+        G->BeginFunction(Func, this);
 
         Index = 0;
         for (auto &Arg: Func->args()) {
             auto Param = Params[Index];
-            auto Alloca = dyn_cast<AllocaInst>(Param->Emit(G));
-            G->Builder->CreateStore(&Arg, Alloca);
+            GLocation Location(G, Param);
+            auto Var = G->CreateVariable(Param->Name, Param->Type, nullptr);
+            if (!G->TryPutValue(Param->Name, Var))
+                return G->ThrowError(Param, "name already exists");
+            G->DescribeVariable(Var, Param, Index + 1);
+            G->StoreVariable(Var, &Arg);
             Index++;
         }
 
         BodyExpr->Emit(G);
 
-        if (ReturnType->isVoidTy())
-            G->Builder->CreateRetVoid();
+        // Falling off the end returns zero, which is what C requires for `main`
+        if (!G->IsTerminated()) {
+            GLocation Location(G, this);
+            if (ReturnType->isVoidTy())
+                G->Builder->CreateRetVoid();
+            else
+                G->Builder->CreateRet(Constant::getNullValue(ReturnType));
+        }
+
+        G->EndFunction();
+        G->InferAttributes(Func);
     } else {
-        Val = G->MainModule->getOrInsertFunction(Name, FuncType).getCallee();
+        Val = G->GetFunction(this, FuncType, false);
     }
 
     G->PopScope();
@@ -507,8 +1263,8 @@ Value *PrototypeNode::Emit(Gen *G) {
 }
 
 llvm::Value *ReturnNode::Emit(Gen *G) {
+    GLocation Location(G, this);
     if (Expr)
-        G->Builder->CreateRet(Expr->Emit(G));
-    else
-        G->Builder->CreateRetVoid();
-}
\ No newline at end of file
+        return G->Builder->CreateRet(G->CastTo(Expr->Emit(G), Expr->Type, Type));
+    return G->Builder->CreateRetVoid();
+}
@@ -2,7 +2,12 @@
 #define GEN_H
 
 #include <fstream>
+#include <set>
 
+#include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/Config/llvm-config.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
@@ -10,59 +15,95 @@
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Constant.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/DIBuilder.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/GlobalValue.h"
 #include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/InstrTypes.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/MDBuilder.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Value.h"
+#include "llvm/IR/ValueHandle.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MD5.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/BuildLibCalls.h"
 
 #include "Parser.h"
+#include "Sema.h"
+#include "SymbolTable.h"
 
 using namespace llvm;
 
-class GStruct {
+// A local or file-scope variable. Scalars whose address is never taken have no
+// stack slot in direct SSA mode, their values are tracked per basic block instead.
+class GVariable {
 public:
-    std::vector<std::string> VarNames;
-    std::vector<Type *> VarTypes;
-    StructType *StrType;
-
-    GStruct(std::vector<std::string> VarNames, std::vector<Type *> VarTypes, StructType *StrType);
-};
-
-class GPointer {
-public:
-    Type *PointeeType;
-    size_t Depth;
+    std::string Name;
+    CType *DeclType;
+    // [N x T] for a fixed-size array, the element type of a variable length one
+    Type *VarType;
+    // Stack slot or global, null for a variable held in SSA form
+    Value *Address;
+    bool IsVLA;
+    // Described local, null without full debug info
+    DILocalVariable *DebugVar;
 };
 
 class GScope {
 public:
-    GScope *Parent;
-    std::map<std::string, AllocaInst *> Allocas;
-    std::map<std::string, GStruct *> Structs;
-    std::map<Value *, GPointer> Pointers;
+    // Stack pointer saved before the first variable length array of the scope
+    Value *StackSave;
+    // Lexical block of a braced scope with full debug info
+    DIScope *DebugScope;
+};
 
-    GScope(GScope *Parent);
+// Source information attached to the generated IR
+enum class DebugInfoKind {
+    NONE,
+    // Instructions carry source locations, so optimization remarks point at
+    // the C source, but no debug info is emitted into the object
+    LOCATIONS,
+    // Line tables only, enough for profilers to attribute samples to lines
+    LINE_TABLES,
+    // Line tables plus types, variables and lexical blocks for debuggers
+    FULL,
 };
 
 class Gen {
 public:
     Gen();
 
+    ~Gen();
+
     LLVMContext *Context;
     IRBuilder<> *Builder;
     Module *MainModule;
 
-    GScope *CurScope;
+    // Innermost scope last
+    std::vector<GScope> Scopes;
+    SymbolTable<GVariable *> Symbols;
 
-    std::map<std::string, Type *> Types;
+    // When set, only the functions and file-scope variables named here are
+    // defined, the others are declared
+    const std::set<std::string> *DefinitionFilter;
+
+    // Builds SSA form for scalar locals while emitting (Braun et al.,
+    // "Simple and Efficient Construction of Static Single Assignment Form")
+    bool DirectSSA;
+
+    // Lets floating point operations be reassociated and assume finite
+    // operands, as -ffast-math does
+    bool FastMath;
+
+    DebugInfoKind DebugInfo;
 
     Type *TVoid;
     Type *TInt8;
@@ -79,25 +120,122 @@ public:
 
     void Save(const std::string &Path) const;
 
-    void PushScope();
+    // Starts a scope, a lexical block for debuggers when Node is given
+    void PushScope(PNode *Node = nullptr);
 
     void PopScope();
 
-    bool TryPutStruct(const std::string Name, GStruct *Str);
+    bool ShouldDefine(const std::string &Name) const;
+
+    // Symbol name of the function Proto declares
+    std::string GetLinkName(PrototypeNode *Proto) const;
+
+    // Returns the function Proto declares, with the calling convention and,
+    // for a definition, the linkage of its specifiers
+    Function *GetFunction(PrototypeNode *Proto, FunctionType *FuncType, bool Define);
+
+    bool TryPutValue(StringRef Name, GVariable *Var);
+
+    bool TryGetValue(StringRef Name, GVariable **VarPtr);
+
+    Type *GetType(CType *Type);
+
+    // Converts a value between C types as an assignment would
+    Value *CastTo(Value *Val, CType *From, CType *To);
+
+    // Prepares the per-function state before the body of the definition Proto is emitted
+    void BeginFunction(Function *Func, PrototypeNode *Proto);
+
+    void EndFunction();
+
+    GVariable *CreateVariable(const std::string &Name, CType *DeclType, Value *ArraySize);
+
+    AllocaInst *CreateEntryAlloca(Type *AllocaType, Value *ArraySize, const std::string &Name);
+
+    // Address of element Index of an array, or of the memory a pointer variable points to
+    Value *CreateElementAddress(GVariable *Var, PNode *IndexExpr, Type **ElementType);
+
+    // Initializes the fixed-size array Var from a braced list, zeroing the rest
+    Value *EmitInitList(GVariable *Var, InitListNode *List);
 
-    bool TryGetStruct(const std::string Name, GStruct **StrPtr);
+    Value *LoadVariable(GVariable *Var);
 
-    bool TryPutValue(const std::string Name, AllocaInst *Alloca);
+    void StoreVariable(GVariable *Var, Value *Val);
 
-    bool TryGetValue(const std::string Name, AllocaInst **AllocaPtr);
+    // Value of a scalar expression compared against zero, as an i1
+    Value *EmitCondition(PNode *Expr);
 
-    bool TryPutPointer(Value *PtrVal, Type *Pointee, size_t Depth);
+    // Branches on a condition, short-circuiting && and || into separate
+    // blocks rather than materializing their truth values. A positive
+    // Likelihood weights the branches towards TrueBlock, a negative one
+    // towards FalseBlock.
+    void EmitBranch(PNode *Cond, BasicBlock *TrueBlock, BasicBlock *FalseBlock, int Likelihood = 0);
 
-    bool TryGetPointer(Value *PtrVal, Type **Pointee, size_t *Depth);
+    // Marks that all predecessors of Block have been emitted
+    void SealBlock(BasicBlock *Block);
+
+    bool IsTerminated() const;
+
+    bool IsFileScope() const;
+
+    // Location of Node in the function being emitted, empty without debug info
+    DebugLoc GetLocation(PNode *Node) const;
+
+    // Describes a variable declared by Decl to debuggers, ArgNo counts
+    // parameters from one and is zero for other variables
+    void DescribeVariable(GVariable *Var, PNode *Decl, unsigned ArgNo);
+
+    // Adds the memory effects and parameter attributes the body of a
+    // finished definition shows, for callers the optimizer cannot look into
+    void InferAttributes(Function *Func);
+
+private:
+    // Known library functions, created for the first declaration
+    std::unique_ptr<TargetLibraryInfoImpl> LibraryInfo;
+
+    std::unique_ptr<DIBuilder> DebugBuilder;
+    DICompileUnit *CompileUnit;
+    DIFile *DebugFile;
+    DISubprogram *Subprogram;
+    std::map<CType *, DIType *> DebugTypes;
+
+    DIScope *GetDebugScope() const;
+
+    DIType *GetDebugType(CType *Type);
+
+    std::vector<std::unique_ptr<GVariable>> Variables;
+    std::set<std::string> AddressTaken;
+    std::map<CType *, StructType *> Structs;
+
+    std::map<BasicBlock *, std::map<GVariable *, WeakTrackingVH>> CurrentDefs;
+    std::map<BasicBlock *, std::map<GVariable *, WeakTrackingVH>> IncompletePhis;
+    std::set<BasicBlock *> SealedBlocks;
+
+    void WriteVariable(GVariable *Var, BasicBlock *Block, Value *Val);
+
+    Value *ReadVariable(GVariable *Var, BasicBlock *Block);
+
+    Value *ReadVariableRecursive(GVariable *Var, BasicBlock *Block);
+
+    PHINode *CreatePhi(GVariable *Var, BasicBlock *Block);
+
+    Value *AddPhiOperands(GVariable *Var, PHINode *Phi);
+
+    Value *TryRemoveTrivialPhi(PHINode *Phi);
+};
+
+// Gives the instructions emitted during its lifetime the location of a node
+// and restores the previous location afterwards, so an operation emitted
+// after its operands is located at the operation again
+class GLocation {
+public:
+    GLocation(Gen *G, PNode *Node);
 
-    bool TryPutType(std::string Name, Type *Type);
+    ~GLocation();
 
-    bool TryGetType(std::string Name, Type **TypePtr);
+private:
+    Gen *G;
+    DebugLoc Saved;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,217 @@
+#include "Incremental.h"
+
+#include <cstring>
+#include <map>
+#include <set>
+
+static void AppendTokens(std::string &Text, const std::vector<Token> &Tokens, PNode *Node,
+                         bool WithPositions = false) {
+    for (size_t i = Node->FirstToken; i <= Node->LastToken && i < Tokens.size(); i++) {
+        const auto &Tok = Tokens[i];
+        if (WithPositions)
+            Text += std::to_string(Tok.Row) + ":" + std::to_string(Tok.Column) + " ";
+        Text += Token::GetName(Tok.Type);
+        switch (Tok.Var.Type) {
+            case VarType::PTR: {
+                std::string Str = Tok.Var.As.CharPtr;
+                Text += " " + std::to_string(Str.size()) + ":" + Str;
+                break;
+            }
+            case VarType::INT8:
+                Text += " " + std::to_string(Tok.Var.As.Char);
+                break;
+            case VarType::INT16:
+                Text += " " + std::to_string(Tok.Var.As.Short);
+                break;
+            case VarType::INT32:
+                Text += " " + std::to_string(Tok.Var.As.Int);
+                break;
+            case VarType::INT64:
+                Text += " " + std::to_string(Tok.Var.As.Long);
+                break;
+            case VarType::FLOAT16:
+            case VarType::FLOAT32: {
+                // Exact bits, a printed float would merge nearby literals
+                uint64_t Bits = 0;
+                if (Tok.Var.Type == VarType::FLOAT16)
+                    memcpy(&Bits, &Tok.Var.As.Float, sizeof(float));
+                else
+                    memcpy(&Bits, &Tok.Var.As.Double, sizeof(double));
+                Text += " " + std::to_string(Bits);
+                break;
+            }
+            default:
+                break;
+        }
+        Text += "\n";
+    }
+}
+
+static std::string GetSignature(PrototypeNode *Proto) {
+    // Specifiers change the symbol name and calling convention of calls
+    std::string Signature = std::string(Proto->IsStatic ? "static " : "") + (Proto->IsInline ? "inline " : "")
+                            + Proto->ReturnAllocNode->ToTypeString() + " " + Proto->Name + "(";
+    for (auto Param: Proto->Params)
+        Signature += Param->ToTypeString() + ",";
+    if (Proto->IsVarArg)
+        Signature += "...";
+    return Signature + ")";
+}
+
+class Uses {
+public:
+    std::set<std::string> TypeNames;
+    std::set<std::string> Callees;
+    std::set<std::string> Identifiers;
+};
+
+static void CollectUses(PNode *Node, Uses &Result) {
+    if (auto Alloc = dynamic_cast<AllocNode *>(Node))
+        Result.TypeNames.insert(Alloc->AllocTypeName);
+    if (auto Call = dynamic_cast<CallNode *>(Node))
+        Result.Callees.insert(Call->CalleeName);
+    if (auto Ident = dynamic_cast<IdentifierNode *>(Node))
+        Result.Identifiers.insert(Ident->Name);
+    // Folded reads of const globals no longer name them
+    Result.Identifiers.insert(Node->FoldedGlobals.begin(), Node->FoldedGlobals.end());
+
+    for (auto Child: Node->GetChildren())
+        CollectUses(Child, Result);
+}
+
+// Appends the declarations of TypeNames, following struct fields and typedefs
+static void AppendTypes(std::string &Fingerprint, const std::vector<Token> &Tokens,
+                        const std::map<std::string, PNode *> &TypeDecls, const std::set<std::string> &TypeNames) {
+    std::set<std::string> Visited;
+    std::vector<std::string> Pending(TypeNames.begin(), TypeNames.end());
+    while (!Pending.empty()) {
+        auto Name = Pending.back();
+        Pending.pop_back();
+        auto It = TypeDecls.find(Name);
+        if (It == TypeDecls.end() || !Visited.insert(Name).second)
+            continue;
+        Uses FieldUses;
+        CollectUses(It->second, FieldUses);
+        Pending.insert(Pending.end(), FieldUses.TypeNames.begin(), FieldUses.TypeNames.end());
+    }
+    for (const auto &Name: Visited) {
+        Fingerprint += "type " + Name + "\n";
+        AppendTokens(Fingerprint, Tokens, TypeDecls.at(Name));
+    }
+}
+
+// Appends the definitions of the functions evaluated at compile time for Node
+static void AppendEvaluated(std::string &Fingerprint, const std::vector<Token> &Tokens,
+                            const std::map<std::string, PrototypeNode *> &Definitions, PNode *Node,
+                            std::set<std::string> &TypeNames) {
+    for (const auto &Name: Node->EvaluatedFunctions) {
+        auto It = Definitions.find(Name);
+        if (It == Definitions.end())
+            continue;
+        Fingerprint += "evaluated " + Name + "\n";
+        AppendTokens(Fingerprint, Tokens, It->second);
+
+        Uses BodyUses;
+        CollectUses(It->second, BodyUses);
+        TypeNames.insert(BodyUses.TypeNames.begin(), BodyUses.TypeNames.end());
+    }
+}
+
+static AllocNode *GetDeclaredVariable(PNode *Node) {
+    if (auto Assign = dynamic_cast<AssignNode *>(Node))
+        return Assign->Alloc;
+    return dynamic_cast<AllocNode *>(Node);
+}
+
+std::vector<FunctionUnit> CollectFunctionUnits(const std::vector<Token> &Tokens, PNode *Root, bool WithPositions) {
+    std::vector<FunctionUnit> Units;
+    auto Block = dynamic_cast<BlockNode *>(Root);
+    if (!Block)
+        return Units;
+
+    // Only declarations that precede a function are visible to it, so moving one
+    // below its user changes the user's fingerprint like it changes the compile
+    std::map<std::string, PNode *> TypeDecls;
+    std::map<std::string, PrototypeNode *> Prototypes;
+    std::map<std::string, PNode *> GlobalDecls;
+
+    // Evaluated functions may be defined anywhere in the file
+    std::map<std::string, PrototypeNode *> Definitions;
+    for (auto Node: Block->Nodes)
+        if (auto Proto = dynamic_cast<PrototypeNode *>(Node); Proto && Proto->BodyExpr)
+            Definitions[Proto->Name] = Proto;
+
+    FunctionUnit Globals{"globals", {}, "globals\n"};
+    Uses GlobalUses;
+
+    for (auto Node: Block->Nodes) {
+        if (auto Struct = dynamic_cast<StructNode *>(Node)) {
+            TypeDecls[Struct->Name] = Struct;
+            continue;
+        }
+        if (auto Typedef = dynamic_cast<TypedefNode *>(Node)) {
+            TypeDecls[Typedef->Alloc->Name] = Typedef;
+            continue;
+        }
+        if (auto Alloc = GetDeclaredVariable(Node)) {
+            GlobalDecls[Alloc->Name] = Node;
+            Globals.Definitions.insert(Alloc->Name);
+            AppendTokens(Globals.Fingerprint, Tokens, Node, WithPositions);
+            CollectUses(Node, GlobalUses);
+            AppendEvaluated(Globals.Fingerprint, Tokens, Definitions, Node, GlobalUses.TypeNames);
+            continue;
+        }
+
+        auto Proto = dynamic_cast<PrototypeNode *>(Node);
+        if (!Proto)
+            continue;
+        Prototypes[Proto->Name] = Proto;
+        if (!Proto->BodyExpr)
+            continue;
+
+        Uses FunctionUses;
+        CollectUses(Proto, FunctionUses);
+
+        FunctionUnit Unit{Proto->Name, {Proto->Name}, "function\n"};
+        // The lines of the other units never reach this object
+        AppendTokens(Unit.Fingerprint, Tokens, Proto, WithPositions);
+
+        for (const auto &Name: FunctionUses.Identifiers) {
+            auto It = GlobalDecls.find(Name);
+            if (It == GlobalDecls.end())
+                continue;
+            Unit.Fingerprint += "global " + Name + "\n";
+            AppendTokens(Unit.Fingerprint, Tokens, It->second);
+
+            Uses DeclUses;
+            CollectUses(It->second, DeclUses);
+            FunctionUses.TypeNames.insert(DeclUses.TypeNames.begin(), DeclUses.TypeNames.end());
+        }
+
+        for (const auto &Name: FunctionUses.Callees) {
+            auto It = Prototypes.find(Name);
+            if (It == Prototypes.end())
+                continue;
+            FunctionUses.TypeNames.insert(It->second->ReturnAllocNode->AllocTypeName);
+            for (auto Param: It->second->Params)
+                FunctionUses.TypeNames.insert(Param->AllocTypeName);
+        }
+
+        AppendEvaluated(Unit.Fingerprint, Tokens, Definitions, Proto, FunctionUses.TypeNames);
+        AppendTypes(Unit.Fingerprint, Tokens, TypeDecls, FunctionUses.TypeNames);
+
+        for (const auto &Name: FunctionUses.Callees) {
+            auto It = Prototypes.find(Name);
+            Unit.Fingerprint += "callee " + (It != Prototypes.end() ? GetSignature(It->second) : Name + " undeclared")
+                                + "\n";
+        }
+
+        Units.push_back(std::move(Unit));
+    }
+
+    if (!Globals.Definitions.empty()) {
+        AppendTypes(Globals.Fingerprint, Tokens, TypeDecls, GlobalUses.TypeNames);
+        Units.push_back(std::move(Globals));
+    }
+    return Units;
+}
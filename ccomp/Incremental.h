@@ -0,0 +1,31 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "Nodes.h"
+#include "Token.h"
+
+// A function definition of a translation unit, or all of its file-scope
+// variables, and the fingerprint of everything its object code depends on: its
+// own tokens, the struct, typedef and variable declarations it uses and the
+// signatures of the functions it calls. Layout and comments are not part of it,
+// and neither are the bodies of other functions, so editing one function
+// leaves the fingerprints of its callers unchanged. The exceptions are functions
+// the folder ran at compile time for the unit, their bodies are in its result.
+class FunctionUnit {
+public:
+    std::string Name;
+    std::set<std::string> Definitions;
+    std::string Fingerprint;
+};
+
+// Splits the top level of Root into units. Tokens must be the stream Root was
+// parsed from. WithPositions adds where the tokens of each unit are, for
+// objects that carry debug information.
+std::vector<FunctionUnit> CollectFunctionUnits(const std::vector<Token> &Tokens, PNode *Root,
+                                               bool WithPositions = false);
+
+#endif
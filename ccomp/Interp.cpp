@@ -0,0 +1,915 @@
+#include "Interp.h"
+
+#include <cstring>
+
+#include "llvm/Support/DynamicLibrary.h"
+
+#ifdef CCOMP_HAVE_FFI
+#include <ffi.h>
+#endif
+
+IType::IType() : BaseKind(VOID), BaseSize(0), PtrDepth(0) {}
+
+IType::IType(Kind BaseKind, size_t BaseSize, size_t PtrDepth) : BaseKind(BaseKind), BaseSize(BaseSize),
+                                                                 PtrDepth(PtrDepth) {}
+
+size_t IType::Size() const {
+    return PtrDepth ? sizeof(char *) : BaseSize;
+}
+
+bool IType::IsPointer() const {
+    return PtrDepth > 0;
+}
+
+bool IType::IsInteger() const {
+    return !PtrDepth && BaseKind == INT;
+}
+
+bool IType::IsFloat() const {
+    return !PtrDepth && BaseKind == FLOAT;
+}
+
+IType IType::Pointee() const {
+    return {BaseKind, BaseSize, PtrDepth ? PtrDepth - 1 : 0};
+}
+
+IType IType::AddressOf() const {
+    return {BaseKind, BaseSize, PtrDepth + 1};
+}
+
+IValue::IValue() : Type() { As.Int = 0; }
+
+IValue IValue::FromInt(int64_t Int, size_t Size) {
+    IValue Val;
+    Val.Type = IType(IType::INT, Size);
+    Val.As.Int = Int;
+    return Val;
+}
+
+IValue IValue::FromFloat(double Float, size_t Size) {
+    IValue Val;
+    Val.Type = IType(IType::FLOAT, Size);
+    Val.As.Float = Float;
+    return Val;
+}
+
+IValue IValue::FromPtr(char *Ptr, IType Type) {
+    IValue Val;
+    Val.Type = Type;
+    Val.As.Ptr = Ptr;
+    return Val;
+}
+
+IScope::IScope(IScope *Parent, char *StackMark) : Parent(Parent), StackMark(StackMark) {}
+
+Interp::Interp(size_t StackSize) : Returning(false), StepLimit(0), Steps(0), DepthLimit(0), Depth(0) {
+    Stack = new char[StackSize];
+    StackTop = Stack;
+    StackEnd = Stack + StackSize;
+
+    GlobalScope = nullptr;
+    CurScope = nullptr;
+
+    Types.emplace("void", IType(IType::VOID, 0));
+    Types.emplace("char", IType(IType::INT, 1));
+    Types.emplace("short", IType(IType::INT, 2));
+    Types.emplace("int", IType(IType::INT, 4));
+    Types.emplace("long", IType(IType::INT, 8));
+    Types.emplace("float", IType(IType::FLOAT, 4));
+    Types.emplace("double", IType(IType::FLOAT, 8));
+}
+
+Interp::~Interp() {
+    while (CurScope)
+        PopScope();
+    delete[] Stack;
+}
+
+IValue Interp::ThrowError(PNode *RelatedNode, std::string Text) {
+    throw CompileError(RelatedNode->Row, RelatedNode->Column,
+                       "error at " + std::to_string(RelatedNode->Row + 1) + ":"
+                       + std::to_string(RelatedNode->Column + 1) + ": " + Text);
+}
+
+int Interp::Run(PNode *Node) {
+    // Global scope holds top-level declarations and outlives every call
+    PushScope();
+    GlobalScope = CurScope;
+
+    // The top-level block is evaluated in place, so file-scope variables stay in the global scope
+    if (auto Block = dynamic_cast<BlockNode *>(Node)) {
+        for (auto Statement: Block->Nodes)
+            Statement->Eval(this);
+    } else
+        Node->Eval(this);
+
+    auto Result = Functions.find("main");
+    if (Result == Functions.end() || !Result->second->BodyExpr)
+        return ThrowError(Node, "no `main` function defined").As.Int;
+
+    std::vector<IValue> Args;
+    IValue ExitVal = Call(nullptr, Result->second, Args);
+    return ExitVal.Type.IsInteger() ? (int) ExitVal.As.Int : 0;
+}
+
+void Interp::PushScope() {
+    CurScope = new IScope(CurScope, StackTop);
+}
+
+void Interp::PopScope() {
+    auto OldScope = CurScope;
+    StackTop = OldScope->StackMark;
+    CurScope = OldScope->Parent;
+    delete OldScope;
+}
+
+bool Interp::TryPutVar(const std::string &Name, IVar Var) {
+    return CurScope->Vars.try_emplace(Name, Var).second;
+}
+
+bool Interp::TryGetVar(const std::string &Name, IVar **VarPtr) {
+    IScope *Scope = CurScope;
+    while (Scope) {
+        auto Result = Scope->Vars.find(Name);
+
+        if (Result != Scope->Vars.end()) {
+            *VarPtr = &Result->second;
+            return true;
+        } else
+            Scope = Scope->Parent;
+    }
+    return false;
+}
+
+bool Interp::TryPutType(const std::string &Name, IType Type) {
+    return Types.try_emplace(Name, Type).second;
+}
+
+bool Interp::TryGetType(const std::string &Name, IType *TypePtr) {
+    auto Result = Types.find(Name);
+    if (Result == Types.end())
+        return false;
+    *TypePtr = Result->second;
+    return true;
+}
+
+bool Interp::TryGetAllocType(AllocNode *Alloc, IType *TypePtr) {
+    if (!TryGetType(Alloc->AllocTypeName, TypePtr))
+        return false;
+    TypePtr->PtrDepth += Alloc->PtrDepth;
+    return true;
+}
+
+char *Interp::Allocate(PNode *RelatedNode, size_t Size) {
+    // Every slot is 16-byte aligned, which covers all scalar and struct types
+    auto Aligned = (Size + 15) & ~(size_t) 15;
+    if (Aligned > (size_t) (StackEnd - StackTop)) {
+        ThrowError(RelatedNode, "stack overflow");
+        return nullptr;
+    }
+    auto Addr = StackTop;
+    StackTop += Aligned;
+    memset(Addr, 0, Size);
+    return Addr;
+}
+
+char *Interp::Address(PNode *Node, IType *TypePtr) {
+    auto Ident = dynamic_cast<IdentifierNode *>(Node);
+    if (!Ident) {
+        auto Ref = dynamic_cast<RefNode *>(Node);
+        if (!Ref || !Ref->IsDeref) {
+            ThrowError(Node, "expression is not assignable");
+            return nullptr;
+        }
+
+        IValue PtrVal = Ref->Expr->Eval(this);
+        for (int i = 1; i < Ref->Depth; i++)
+            PtrVal = Load(PtrVal.As.Ptr, PtrVal.Type.Pointee());
+
+        if (!PtrVal.Type.IsPointer())
+            ThrowError(Node, "cannot dereference not pointer");
+        *TypePtr = PtrVal.Type.Pointee();
+        return PtrVal.As.Ptr;
+    }
+
+    IVar *Var;
+    if (!TryGetVar(Ident->Name, &Var)) {
+        ThrowError(Node, "unknown variable name `" + Ident->Name + "`");
+        return nullptr;
+    }
+
+    if (!Ident->IndexExpr) {
+        *TypePtr = Var->Type;
+        return Var->Addr;
+    }
+
+    IValue Index = Convert(Ident->IndexExpr->Eval(this), IType(IType::INT, 8));
+
+    char *Base;
+    IType ElType;
+    if (Var->IsArray) {
+        Base = Var->Addr;
+        ElType = Var->Type;
+    } else if (Var->Type.IsPointer()) {
+        Base = Load(Var->Addr, Var->Type).As.Ptr;
+        ElType = Var->Type.Pointee();
+    } else {
+        ThrowError(Node, "indexee must be array or a pointer");
+        return nullptr;
+    }
+
+    *TypePtr = ElType;
+    return Base + Index.As.Int * (int64_t) ElType.Size();
+}
+
+IValue Interp::Load(const char *Addr, IType Type) {
+    IValue Val;
+    Val.Type = Type;
+
+    if (Type.IsPointer()) {
+        memcpy(&Val.As.Ptr, Addr, sizeof(char *));
+        return Val;
+    }
+
+    switch (Type.BaseKind) {
+        case IType::INT:
+            switch (Type.BaseSize) {
+                case 1: {
+                    int8_t V;
+                    memcpy(&V, Addr, 1);
+                    Val.As.Int = V;
+                    break;
+                }
+                case 2: {
+                    int16_t V;
+                    memcpy(&V, Addr, 2);
+                    Val.As.Int = V;
+                    break;
+                }
+                case 4: {
+                    int32_t V;
+                    memcpy(&V, Addr, 4);
+                    Val.As.Int = V;
+                    break;
+                }
+                default:
+                    memcpy(&Val.As.Int, Addr, 8);
+                    break;
+            }
+            break;
+        case IType::FLOAT:
+            if (Type.BaseSize == 4) {
+                float V;
+                memcpy(&V, Addr, 4);
+                Val.As.Float = V;
+            } else
+                memcpy(&Val.As.Float, Addr, 8);
+            break;
+        default:
+            // Aggregates are passed around by address
+            Val.As.Ptr = const_cast<char *>(Addr);
+            break;
+    }
+    return Val;
+}
+
+void Interp::Store(char *Addr, IType Type, IValue Val) {
+    if (Type.BaseKind == IType::STRUCT && !Type.IsPointer()) {
+        memmove(Addr, Val.As.Ptr, Type.Size());
+        return;
+    }
+
+    Val = Convert(Val, Type);
+
+    if (Type.IsPointer()) {
+        memcpy(Addr, &Val.As.Ptr, sizeof(char *));
+        return;
+    }
+
+    if (Type.BaseKind == IType::INT) {
+        int8_t V8 = (int8_t) Val.As.Int;
+        int16_t V16 = (int16_t) Val.As.Int;
+        int32_t V32 = (int32_t) Val.As.Int;
+        switch (Type.BaseSize) {
+            case 1:
+                memcpy(Addr, &V8, 1);
+                break;
+            case 2:
+                memcpy(Addr, &V16, 2);
+                break;
+            case 4:
+                memcpy(Addr, &V32, 4);
+                break;
+            default:
+                memcpy(Addr, &Val.As.Int, 8);
+                break;
+        }
+    } else if (Type.BaseKind == IType::FLOAT) {
+        if (Type.BaseSize == 4) {
+            float V = (float) Val.As.Float;
+            memcpy(Addr, &V, 4);
+        } else
+            memcpy(Addr, &Val.As.Float, 8);
+    }
+}
+
+IValue Interp::Convert(IValue Val, IType To) {
+    IValue Res;
+    Res.Type = To;
+
+    if (To.IsPointer()) {
+        Res.As.Ptr = Val.Type.IsInteger() ? (char *) (intptr_t) Val.As.Int : Val.As.Ptr;
+        return Res;
+    }
+
+    switch (To.BaseKind) {
+        case IType::INT: {
+            int64_t Int;
+            if (Val.Type.IsFloat())
+                Int = (int64_t) Val.As.Float;
+            else if (Val.Type.IsPointer())
+                Int = (int64_t) (intptr_t) Val.As.Ptr;
+            else
+                Int = Val.As.Int;
+
+            switch (To.BaseSize) {
+                case 1:
+                    Res.As.Int = (int8_t) Int;
+                    break;
+                case 2:
+                    Res.As.Int = (int16_t) Int;
+                    break;
+                case 4:
+                    Res.As.Int = (int32_t) Int;
+                    break;
+                default:
+                    Res.As.Int = Int;
+                    break;
+            }
+            return Res;
+        }
+        case IType::FLOAT: {
+            double Float = Val.Type.IsFloat() ? Val.As.Float : (double) Val.As.Int;
+            Res.As.Float = To.BaseSize == 4 ? (double) (float) Float : Float;
+            return Res;
+        }
+        default:
+            return Val;
+    }
+}
+
+bool Interp::IsTrue(IValue Val) {
+    if (Val.Type.IsPointer())
+        return Val.As.Ptr != nullptr;
+    if (Val.Type.IsFloat())
+        return Val.As.Float != 0.0;
+    return Val.As.Int != 0;
+}
+
+IValue Interp::Call(CallNode *Site, PrototypeNode *Callee, std::vector<IValue> &Args) {
+    if (!Callee->BodyExpr)
+        return CallExternal(Site, Callee, Args);
+
+    PNode *Related = Site ? (PNode *) Site : (PNode *) Callee;
+    if (Args.size() != Callee->Params.size())
+        return ThrowError(Related, "incorrect # arguments passed");
+
+    Step(Related);
+    if (DepthLimit && Depth >= DepthLimit)
+        return ThrowError(Related, "call nesting too deep");
+
+    // Callee body sees its own parameters and the globals, never the caller's locals
+    auto CallerScope = CurScope;
+    CurScope = GlobalScope;
+    PushScope();
+
+    for (size_t i = 0; i < Args.size(); i++) {
+        auto Param = Callee->Params[i];
+        IType ParamType;
+        if (!TryGetAllocType(Param, &ParamType))
+            return ThrowError(Param, "unknown type");
+
+        IVar Var{ParamType, Allocate(Param, ParamType.Size()), false};
+        Store(Var.Addr, ParamType, Args[i]);
+        if (!TryPutVar(Param->Name, Var))
+            return ThrowError(Param, "name already exists");
+    }
+
+    Depth++;
+    Callee->BodyExpr->Eval(this);
+    Depth--;
+
+    IValue Result = RetVal;
+    Returning = false;
+    RetVal = IValue();
+
+    PopScope();
+    CurScope = CallerScope;
+
+    IType ReturnType;
+    if (!TryGetAllocType(Callee->ReturnAllocNode, &ReturnType))
+        return ThrowError(Callee, "unknown type");
+    if (ReturnType.BaseKind == IType::VOID && !ReturnType.IsPointer())
+        return IValue();
+    return Convert(Result, ReturnType);
+}
+
+void Interp::Step(PNode *RelatedNode) {
+    if (StepLimit && ++Steps > StepLimit)
+        ThrowError(RelatedNode, "evaluation step limit exceeded");
+}
+
+bool Interp::TryEvaluate(PrototypeNode *Callee, std::vector<IValue> &Args, IValue *ResultPtr) {
+    auto SavedScope = CurScope;
+    auto SavedTop = StackTop;
+    Steps = 0;
+    Depth = 0;
+
+    try {
+        *ResultPtr = Call(nullptr, Callee, Args);
+        return true;
+    } catch (CompileError &) {
+        // Unwind whatever the failed call left behind
+        while (CurScope != SavedScope)
+            PopScope();
+        StackTop = SavedTop;
+        Returning = false;
+        RetVal = IValue();
+        return false;
+    }
+}
+
+#ifdef CCOMP_HAVE_FFI
+static ffi_type *GetFFIType(IType Type) {
+    if (Type.IsPointer())
+        return &ffi_type_pointer;
+
+    switch (Type.BaseKind) {
+        case IType::INT:
+            switch (Type.BaseSize) {
+                case 1:
+                    return &ffi_type_sint8;
+                case 2:
+                    return &ffi_type_sint16;
+                case 4:
+                    return &ffi_type_sint32;
+                default:
+                    return &ffi_type_sint64;
+            }
+        case IType::FLOAT:
+            return Type.BaseSize == 4 ? &ffi_type_float : &ffi_type_double;
+        case IType::VOID:
+            return &ffi_type_void;
+        default:
+            return nullptr;
+    }
+}
+#endif
+
+IValue Interp::CallExternal(CallNode *Site, PrototypeNode *Callee, std::vector<IValue> &Args) {
+    PNode *Related = Site ? (PNode *) Site : (PNode *) Callee;
+
+#ifdef CCOMP_HAVE_FFI
+    static bool ProcessLoaded = llvm::sys::DynamicLibrary::LoadLibraryPermanently(nullptr);
+    (void) ProcessLoaded;
+
+    void *Addr = llvm::sys::DynamicLibrary::SearchForAddressOfSymbol(Callee->Name);
+    if (!Addr)
+        return ThrowError(Related, "unresolved external function `" + Callee->Name + "`");
+
+    if (Args.size() < Callee->Params.size() || (!Callee->IsVarArg && Args.size() != Callee->Params.size()))
+        return ThrowError(Related, "incorrect # arguments passed");
+
+    // Fixed arguments take the declared parameter types, variadic ones the default promotions
+    std::vector<IValue> Values;
+    for (size_t i = 0; i < Args.size(); i++) {
+        IType ArgType = Args[i].Type;
+        if (i < Callee->Params.size()) {
+            if (!TryGetAllocType(Callee->Params[i], &ArgType))
+                return ThrowError(Callee->Params[i], "unknown type");
+        } else if (ArgType.IsInteger() && ArgType.BaseSize < 4)
+            ArgType = IType(IType::INT, 4);
+        else if (ArgType.IsFloat())
+            ArgType = IType(IType::FLOAT, 8);
+        Values.push_back(Convert(Args[i], ArgType));
+    }
+
+    union ArgSlot {
+        int8_t Int8;
+        int16_t Int16;
+        int32_t Int32;
+        int64_t Int64;
+        float Float32;
+        double Float64;
+        char *Ptr;
+    };
+
+    std::vector<ArgSlot> Slots(Values.size());
+    std::vector<ffi_type *> ArgTypes;
+    std::vector<void *> ArgPtrs;
+    for (size_t i = 0; i < Values.size(); i++) {
+        auto &Val = Values[i];
+        auto &Slot = Slots[i];
+        auto FFIType = GetFFIType(Val.Type);
+        if (!FFIType || FFIType == &ffi_type_void)
+            return ThrowError(Related, "unsupported argument type in external call");
+
+        if (Val.Type.IsPointer())
+            Slot.Ptr = Val.As.Ptr;
+        else if (Val.Type.IsFloat() && Val.Type.BaseSize == 4)
+            Slot.Float32 = (float) Val.As.Float;
+        else if (Val.Type.IsFloat())
+            Slot.Float64 = Val.As.Float;
+        else if (Val.Type.BaseSize == 1)
+            Slot.Int8 = (int8_t) Val.As.Int;
+        else if (Val.Type.BaseSize == 2)
+            Slot.Int16 = (int16_t) Val.As.Int;
+        else if (Val.Type.BaseSize == 4)
+            Slot.Int32 = (int32_t) Val.As.Int;
+        else
+            Slot.Int64 = Val.As.Int;
+
+        ArgTypes.push_back(FFIType);
+        ArgPtrs.push_back(&Slot);
+    }
+
+    IType ReturnType;
+    if (!TryGetAllocType(Callee->ReturnAllocNode, &ReturnType))
+        return ThrowError(Callee, "unknown type");
+    auto FFIReturnType = GetFFIType(ReturnType);
+    if (!FFIReturnType)
+        return ThrowError(Related, "unsupported return type in external call");
+
+    ffi_cif Cif;
+    ffi_status Status;
+    if (Callee->IsVarArg)
+        Status = ffi_prep_cif_var(&Cif, FFI_DEFAULT_ABI, Callee->Params.size(), ArgTypes.size(), FFIReturnType,
+                                  ArgTypes.data());
+    else
+        Status = ffi_prep_cif(&Cif, FFI_DEFAULT_ABI, ArgTypes.size(), FFIReturnType, ArgTypes.data());
+    if (Status != FFI_OK)
+        return ThrowError(Related, "cannot prepare external call to `" + Callee->Name + "`");
+
+    // ffi widens integral results narrower than a register to ffi_arg
+    union {
+        ffi_sarg Int;
+        float Float32;
+        double Float64;
+        char *Ptr;
+    } Ret{};
+    ffi_call(&Cif, FFI_FN(Addr), &Ret, ArgPtrs.data());
+
+    if (ReturnType.IsPointer())
+        return IValue::FromPtr(Ret.Ptr, ReturnType);
+    if (ReturnType.IsFloat())
+        return IValue::FromFloat(ReturnType.BaseSize == 4 ? Ret.Float32 : Ret.Float64, ReturnType.BaseSize);
+    if (ReturnType.IsInteger())
+        return Convert(IValue::FromInt(Ret.Int, 8), ReturnType);
+    return IValue();
+#else
+    return ThrowError(Related, "external call to `" + Callee->Name + "` requires libffi");
+#endif
+}
+
+IValue IdentifierNode::Eval(Interp *I) {
+    IVar *Var;
+    if (!I->TryGetVar(Name, &Var))
+        return I->ThrowError(this, "unknown variable name `" + Name + "`");
+
+    // Arrays decay to a pointer to their first element
+    if (Var->IsArray && !IndexExpr)
+        return IValue::FromPtr(Var->Addr, Var->Type.AddressOf());
+
+    IType Type;
+    char *Addr = I->Address(this, &Type);
+    return I->Load(Addr, Type);
+}
+
+IValue IntegerNode::Eval(Interp *I) {
+    IValue Val = IValue::FromInt((int64_t) Value, NumBits / 8);
+    return I->Convert(Val, Val.Type);
+}
+
+IValue FloatNode::Eval(Interp *) {
+    return IValue::FromFloat(Value);
+}
+
+IValue StringNode::Eval(Interp *) {
+    return IValue::FromPtr(const_cast<char *>(Text.c_str()), IType(IType::INT, 1, 1));
+}
+
+IValue BinOpNode::Eval(Interp *I) {
+    if (OpType == TType::AND)
+        return IValue::FromInt(I->IsTrue(LHS->Eval(I)) && I->IsTrue(RHS->Eval(I)));
+    if (OpType == TType::OR)
+        return IValue::FromInt(I->IsTrue(LHS->Eval(I)) || I->IsTrue(RHS->Eval(I)));
+
+    IValue L = LHS->Eval(I);
+    IValue R = RHS->Eval(I);
+
+    if (L.Type.IsPointer() || R.Type.IsPointer()) {
+        if (OpType == TType::PLUS || OpType == TType::MINUS) {
+            if (L.Type.IsPointer() && R.Type.IsPointer()) {
+                if (OpType == TType::PLUS)
+                    return I->ThrowError(this, "cannot add two pointers");
+                auto Size = (int64_t) std::max<size_t>(L.Type.Pointee().Size(), 1);
+                return IValue::FromInt((L.As.Ptr - R.As.Ptr) / Size, 8);
+            }
+            auto Ptr = L.Type.IsPointer() ? L : R;
+            auto Offset = L.Type.IsPointer() ? R : L;
+            auto Scaled = Offset.As.Int * (int64_t) Ptr.Type.Pointee().Size();
+            return IValue::FromPtr(Ptr.As.Ptr + (OpType == TType::PLUS ? Scaled : -Scaled), Ptr.Type);
+        }
+
+        auto LPtr = I->Convert(L, IType(IType::INT, 8)).As.Int;
+        auto RPtr = I->Convert(R, IType(IType::INT, 8)).As.Int;
+        switch (OpType) {
+            case TType::D_EQUAL:
+                return IValue::FromInt(LPtr == RPtr);
+            case TType::BANG_EQ:
+                return IValue::FromInt(LPtr != RPtr);
+            case TType::LESS:
+                return IValue::FromInt(LPtr < RPtr);
+            case TType::LESS_EQ:
+                return IValue::FromInt(LPtr <= RPtr);
+            case TType::GREAT:
+                return IValue::FromInt(LPtr > RPtr);
+            case TType::GREAT_EQ:
+                return IValue::FromInt(LPtr >= RPtr);
+            default:
+                return I->ThrowError(this, "invalid operands to binary " + Token::GetName(OpType));
+        }
+    }
+
+    if (L.Type.IsFloat() || R.Type.IsFloat()) {
+        auto Size = std::max(L.Type.IsFloat() ? L.Type.BaseSize : 0, R.Type.IsFloat() ? R.Type.BaseSize : 0);
+        auto Type = IType(IType::FLOAT, Size);
+        double LV = I->Convert(L, Type).As.Float;
+        double RV = I->Convert(R, Type).As.Float;
+        switch (OpType) {
+            case TType::PLUS:
+                return I->Convert(IValue::FromFloat(LV + RV), Type);
+            case TType::MINUS:
+                return I->Convert(IValue::FromFloat(LV - RV), Type);
+            case TType::STAR:
+                return I->Convert(IValue::FromFloat(LV * RV), Type);
+            case TType::SLASH:
+                return I->Convert(IValue::FromFloat(LV / RV), Type);
+            case TType::D_EQUAL:
+                return IValue::FromInt(LV == RV);
+            case TType::BANG_EQ:
+                return IValue::FromInt(LV != RV);
+            case TType::LESS:
+                return IValue::FromInt(LV < RV);
+            case TType::LESS_EQ:
+                return IValue::FromInt(LV <= RV);
+            case TType::GREAT:
+                return IValue::FromInt(LV > RV);
+            case TType::GREAT_EQ:
+                return IValue::FromInt(LV >= RV);
+            default:
+                return I->ThrowError(this, "invalid operands to binary " + Token::GetName(OpType));
+        }
+    }
+
+    // Integer promotion: everything narrower than int is computed as int
+    auto Type = IType(IType::INT, std::max<size_t>(4, std::max(L.Type.BaseSize, R.Type.BaseSize)));
+    int64_t LV = L.As.Int;
+    int64_t RV = R.As.Int;
+    IValue Res;
+    switch (OpType) {
+        case TType::PLUS:
+            Res = IValue::FromInt((int64_t) ((uint64_t) LV + (uint64_t) RV));
+            break;
+        case TType::MINUS:
+            Res = IValue::FromInt((int64_t) ((uint64_t) LV - (uint64_t) RV));
+            break;
+        case TType::STAR:
+            Res = IValue::FromInt((int64_t) ((uint64_t) LV * (uint64_t) RV));
+            break;
+        case TType::SLASH:
+        case TType::PERCENT:
+            if (RV == 0)
+                return I->ThrowError(this, "division by zero");
+            Res = IValue::FromInt(OpType == TType::SLASH ? LV / RV : LV % RV);
+            break;
+        case TType::BIN_OR:
+            Res = IValue::FromInt(LV | RV);
+            break;
+        case TType::BIN_AND:
+            Res = IValue::FromInt(LV & RV);
+            break;
+        case TType::D_EQUAL:
+            return IValue::FromInt(LV == RV);
+        case TType::BANG_EQ:
+            return IValue::FromInt(LV != RV);
+        case TType::LESS:
+            return IValue::FromInt(LV < RV);
+        case TType::LESS_EQ:
+            return IValue::FromInt(LV <= RV);
+        case TType::GREAT:
+            return IValue::FromInt(LV > RV);
+        case TType::GREAT_EQ:
+            return IValue::FromInt(LV >= RV);
+        default:
+            return I->ThrowError(this, "invalid operands to binary " + Token::GetName(OpType));
+    }
+    return I->Convert(Res, Type);
+}
+
+IValue UnOpNode::Eval(Interp *I) {
+    IValue Val = Expr->Eval(I);
+    switch (OpType) {
+        case TType::BANG:
+            return IValue::FromInt(!I->IsTrue(Val));
+        case TType::MINUS:
+            if (Val.Type.IsFloat())
+                return IValue::FromFloat(-Val.As.Float, Val.Type.BaseSize);
+            if (Val.Type.IsInteger())
+                return I->Convert(IValue::FromInt((int64_t) (0 - (uint64_t) Val.As.Int)),
+                                  IType(IType::INT, std::max<size_t>(4, Val.Type.BaseSize)));
+            return I->ThrowError(this, "invalid operand to unary -");
+        default:
+            return I->ThrowError(this, "unknown unary operator");
+    }
+}
+
+IValue AssignNode::Eval(Interp *I) {
+    if (Alloc)
+        Alloc->Eval(I);
+
+    // The array was allocated zeroed, only the listed elements are stored
+    if (auto List = dynamic_cast<InitListNode *>(Expr)) {
+        IVar *Var;
+        if (!I->TryGetVar(Alloc->Name, &Var))
+            return I->ThrowError(this, "unknown variable name");
+        for (size_t i = 0; i < List->Elements.size(); i++)
+            I->Store(Var->Addr + i * Var->Type.Size(), Var->Type, List->Elements[i]->Eval(I));
+        return IValue::FromPtr(Var->Addr, Var->Type.AddressOf());
+    }
+
+    IValue Val = Expr->Eval(I);
+
+    IType Type;
+    char *Addr;
+    if (Alloc) {
+        IVar *Var;
+        if (!I->TryGetVar(Alloc->Name, &Var))
+            return I->ThrowError(this, "unknown variable name");
+        Type = Var->Type;
+        Addr = Var->Addr;
+    } else
+        Addr = I->Address(Ident, &Type);
+
+    I->Store(Addr, Type, Val);
+    return I->Load(Addr, Type);
+}
+
+IValue InitListNode::Eval(Interp *I) {
+    return I->ThrowError(this, "initializer list outside of a declaration");
+}
+
+IValue RefNode::Eval(Interp *I) {
+    if (IsDeref) {
+        IValue Val = Expr->Eval(I);
+        for (int i = 0; i < Depth; i++) {
+            if (!Val.Type.IsPointer())
+                return I->ThrowError(Expr, "cannot dereference not pointer");
+            if (!Val.As.Ptr)
+                return I->ThrowError(this, "null pointer dereference");
+            Val = I->Load(Val.As.Ptr, Val.Type.Pointee());
+        }
+        return Val;
+    }
+
+    if (!dynamic_cast<IdentifierNode *>(Expr))
+        return I->ThrowError(this, "cannot reference not identifier");
+
+    IType Type;
+    char *Addr = I->Address(Expr, &Type);
+    return IValue::FromPtr(Addr, Type.AddressOf());
+}
+
+IValue AllocNode::Eval(Interp *I) {
+    IType Type;
+    if (!I->TryGetAllocType(this, &Type))
+        return I->ThrowError(this, "unknown type");
+
+    size_t Count = 1;
+    if (ArraySizeExpr) {
+        auto CountVal = I->Convert(ArraySizeExpr->Eval(I), IType(IType::INT, 8));
+        if (CountVal.As.Int < 0)
+            return I->ThrowError(this, "negative array size");
+        Count = (size_t) CountVal.As.Int;
+    }
+
+    IVar Var{Type, I->Allocate(this, Type.Size() * Count), ArraySizeExpr != nullptr};
+    if (!I->TryPutVar(Name, Var))
+        return I->ThrowError(this, "name already exists");
+    return IValue::FromPtr(Var.Addr, Type.AddressOf());
+}
+
+IValue StructNode::Eval(Interp *I) {
+    size_t Size = 0;
+    size_t Align = 1;
+    for (auto Alloc : AllocNodes) {
+        IType FieldType;
+        if (!I->TryGetAllocType(Alloc, &FieldType))
+            return I->ThrowError(this, "unknown type");
+
+        auto FieldSize = FieldType.Size();
+        auto FieldAlign = std::max<size_t>(1, std::min<size_t>(FieldSize, 8));
+        Size = (Size + FieldAlign - 1) / FieldAlign * FieldAlign + FieldSize;
+        Align = std::max(Align, FieldAlign);
+    }
+    Size = (Size + Align - 1) / Align * Align;
+
+    if (!I->TryPutType(Name, IType(IType::STRUCT, Size)))
+        return I->ThrowError(this, "struct name already exists");
+    return IValue();
+}
+
+IValue TypedefNode::Eval(Interp *I) {
+    IType DefType;
+    if (!I->TryGetAllocType(Alloc, &DefType))
+        return I->ThrowError(this, "unknown type");
+
+    if (!I->TryPutType(Alloc->Name, DefType))
+        return I->ThrowError(this, "type exists");
+    return IValue();
+}
+
+IValue BlockNode::Eval(Interp *I) {
+    I->PushScope();
+    for (auto Node: Nodes) {
+        Node->Eval(I);
+        if (I->Returning)
+            break;
+    }
+    I->PopScope();
+    return IValue();
+}
+
+IValue IfNode::Eval(Interp *I) {
+    if (I->IsTrue(CondExpr->Eval(I)))
+        BodyExpr->Eval(I);
+    else if (ElseBrExpr)
+        ElseBrExpr->Eval(I);
+    return IValue();
+}
+
+IValue ForNode::Eval(Interp *I) {
+    I->PushScope();
+
+    if (InitExpr)
+        InitExpr->Eval(I);
+
+    while (!CondExpr || I->IsTrue(CondExpr->Eval(I))) {
+        I->Step(this);
+        BodyExpr->Eval(I);
+        if (I->Returning)
+            break;
+        if (UpdateExpr)
+            UpdateExpr->Eval(I);
+    }
+
+    I->PopScope();
+    return IValue();
+}
+
+IValue CallNode::Eval(Interp *I) {
+    // The hint only matters to code generation
+    if (IsBuiltinExpect()) {
+        auto Val = ArgExprs[0]->Eval(I);
+        ArgExprs[1]->Eval(I);
+        return I->Convert(Val, IType(IType::INT, 8));
+    }
+
+    auto Result = I->Functions.find(CalleeName);
+    if (Result == I->Functions.end())
+        return I->ThrowError(this, "unknown function referenced");
+
+    std::vector<IValue> ArgVals;
+    for (auto &ArgExpr: ArgExprs)
+        ArgVals.push_back(ArgExpr->Eval(I));
+
+    return I->Call(this, Result->second, ArgVals);
+}
+
+IValue PrototypeNode::Eval(Interp *I) {
+    auto Result = I->Functions.find(Name);
+    if (Result == I->Functions.end())
+        I->Functions.emplace(Name, this);
+    else if (BodyExpr) {
+        if (Result->second->BodyExpr)
+            return I->ThrowError(this, "redefinition of `" + Name + "`");
+        Result->second = this;
+    }
+    return IValue();
+}
+
+IValue ReturnNode::Eval(Interp *I) {
+    I->RetVal = Expr ? Expr->Eval(I) : IValue();
+    I->Returning = true;
+    return IValue();
+}
@@ -0,0 +1,141 @@
+#ifndef INTERP_H
+#define INTERP_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Parser.h"
+
+class IType {
+public:
+    enum Kind {
+        VOID,
+        INT,
+        FLOAT,
+        STRUCT,
+    };
+
+    Kind BaseKind;
+    size_t BaseSize;
+    size_t PtrDepth;
+
+    IType();
+
+    IType(Kind BaseKind, size_t BaseSize, size_t PtrDepth = 0);
+
+    size_t Size() const;
+
+    bool IsPointer() const;
+
+    bool IsInteger() const;
+
+    bool IsFloat() const;
+
+    IType Pointee() const;
+
+    IType AddressOf() const;
+};
+
+class IValue {
+public:
+    IType Type;
+    union {
+        int64_t Int;
+        double Float;
+        char *Ptr;
+    } As;
+
+    IValue();
+
+    static IValue FromInt(int64_t Int, size_t Size = 4);
+
+    static IValue FromFloat(double Float, size_t Size = 8);
+
+    static IValue FromPtr(char *Ptr, IType Type);
+};
+
+class IVar {
+public:
+    IType Type;
+    char *Addr;
+    bool IsArray;
+};
+
+class IScope {
+public:
+    IScope *Parent;
+    char *StackMark;
+    std::map<std::string, IVar> Vars;
+
+    IScope(IScope *Parent, char *StackMark);
+};
+
+class Interp {
+public:
+    explicit Interp(size_t StackSize = 8 << 20);
+
+    ~Interp();
+
+    IScope *GlobalScope;
+    IScope *CurScope;
+
+    std::map<std::string, IType> Types;
+    std::map<std::string, PrototypeNode *> Functions;
+
+    bool Returning;
+    IValue RetVal;
+
+    // Budgets of compile-time evaluation, zero means unlimited. Every call and
+    // loop iteration takes a step.
+    uint64_t StepLimit;
+    uint64_t Steps;
+    size_t DepthLimit;
+    size_t Depth;
+
+    IValue ThrowError(PNode *RelatedNode, std::string Text);
+
+    int Run(PNode *Node);
+
+    void PushScope();
+
+    void PopScope();
+
+    bool TryPutVar(const std::string &Name, IVar Var);
+
+    bool TryGetVar(const std::string &Name, IVar **VarPtr);
+
+    bool TryPutType(const std::string &Name, IType Type);
+
+    bool TryGetType(const std::string &Name, IType *TypePtr);
+
+    bool TryGetAllocType(AllocNode *Alloc, IType *TypePtr);
+
+    char *Allocate(PNode *RelatedNode, size_t Size);
+
+    char *Address(PNode *Node, IType *TypePtr);
+
+    IValue Load(const char *Addr, IType Type);
+
+    void Store(char *Addr, IType Type, IValue Val);
+
+    IValue Convert(IValue Val, IType To);
+
+    bool IsTrue(IValue Val);
+
+    IValue Call(CallNode *Site, PrototypeNode *Callee, std::vector<IValue> &Args);
+
+    void Step(PNode *RelatedNode);
+
+    // Calls Callee outside of any program run, false if it fails or exceeds a budget
+    bool TryEvaluate(PrototypeNode *Callee, std::vector<IValue> &Args, IValue *ResultPtr);
+
+private:
+    char *Stack;
+    char *StackTop;
+    char *StackEnd;
+
+    IValue CallExternal(CallNode *Site, PrototypeNode *Callee, std::vector<IValue> &Args);
+};
+
+#endif
@@ -2,7 +2,7 @@
 
 #include <utility>
 
-map<string, TType> LexerKeywords = {
+static const map<string, TType> LexerKeywords = {
         {"return",  TType::RETURN},
         {"if",      TType::IF},
         {"else",    TType::ELSE},
@@ -10,6 +10,11 @@ map<string, TType> LexerKeywords = {
         {"while",   TType::WHILE},
         {"struct",  TType::STRUCT},
         {"typedef", TType::TYPEDEF},
+        {"static",  TType::STATIC},
+        {"inline",  TType::INLINE},
+        {"restrict", TType::RESTRICT},
+        {"__restrict", TType::RESTRICT},
+        {"const",   TType::CONST},
 
 };
 
@@ -87,6 +92,9 @@ void Lexer::ParseToken() {
         case ',':
             Put(TType::COMMA);
             break;
+        case '#':
+            Put(TType::HASH);
+            break;
         case '.':
             if (Peek(1) == '.' || Peek(2) == '.') {
                 Advance();
@@ -230,11 +238,9 @@ void Lexer::Name() {
 
     string Text = SrcText.substr(Start, Current - Start);
 
-    if (Text == "const")
-        return;
-
-    if (LexerKeywords.find(Text) != LexerKeywords.end())
-        Put(LexerKeywords[Text]);
+    auto Keyword = LexerKeywords.find(Text);
+    if (Keyword != LexerKeywords.end())
+        Put(Keyword->second);
     else
         Put(TType::IDENTIFIER, AllocCharArray(Text));
 }
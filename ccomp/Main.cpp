@@ -1,83 +1,830 @@
 ﻿#include "Main.h"
 #include "Lexer.h"
 #include "Parser.h"
+#include "Sema.h"
+#include "Fold.h"
 #include "Gen.h"
+#include "Interp.h"
+#include "Backend.h"
+#include "Cache.h"
+#include "Incremental.h"
 
-int main(int argc, char** argv)
+#include <algorithm>
+#include <chrono>
+#include <set>
+#include <sstream>
+
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/MCJIT.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Regex.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ThreadPool.h"
+
+static const char* Usage =
+	"usage: ccomp [options] <file.c>...\n"
+	"  -o <path>              output file (default a.out)\n"
+	"  -c                     compile to object files without linking\n"
+	"  -emit-llvm             write textual IR for each file instead of objects\n"
+	"  -O<n>                  optimization level 0-3\n"
+	"  -j <n>                 compile on <n> threads\n"
+	"  -fcodegen-units=<n>    partitions for parallel codegen of a single file (default 1)\n"
+	"  -run                   run the linked executable\n"
+	"  -interpret             run a single file in the interpreter\n"
+	"  -bench                 compare interpreter and jit startup latency\n"
+	"  -dump-tokens           print the token stream\n"
+	"  -dump-ast              print the syntax tree\n"
+	"  -fsyntax-only          check the input files for errors and stop\n"
+	"  -fcache-dir=<dir>      reuse objects from an on-disk cache (or set CCOMP_CACHE_DIR)\n"
+	"  -fcache-size=<MiB>     evict least recently used objects above this size (default 1024)\n"
+	"  -cache-stats           print cache hit rate statistics\n"
+	"  -fincremental          recompile only the functions that changed (needs a cache)\n"
+	"  -fssa                  build SSA form for scalar locals while generating IR\n"
+	"  -ffast-math            allow floating point reassociation and assume finite values\n"
+	"  -g                     emit DWARF line tables, types and variables\n"
+	"  -gline-tables-only     emit DWARF line tables only\n"
+	"  -g0                    emit no debug information\n"
+	"  -fprofile-generate     instrument the program to write a profile to default.profraw\n"
+	"  -fprofile-use=<file>   optimize with the profile merged into <file> by llvm-profdata,\n"
+	"                         with function sections and cold code split into .text.unlikely\n"
+	"  -ffunction-sections    place each function in a section of its own\n"
+	"  -fsymbol-ordering-file=<path>  list the functions the profile ran, hottest first, for\n"
+	"                         the --symbol-ordering-file option of the linker\n"
+	"  -Rpass=<regex>         report optimizations done by passes matching <regex>\n"
+	"  -Rpass-missed=<regex>  report optimizations missed by passes matching <regex>\n"
+	"  -Rpass-analysis=<regex> report the analyses behind the decisions of matching passes\n"
+	"  -fsave-optimization-record  record all remarks to <file>.opt.yaml\n"
+	"  -foptimization-record-file=<path>  record all remarks of a single file to <path>\n"
+	"  -flto                  link all files into one module and optimize the whole program\n"
+	"  -exported-symbol=<name>  keep <name> visible to other programs with -flto\n"
+	"  -mllvm <arg>           pass an option to LLVM\n";
+
+static double MillisecondsSince(std::chrono::steady_clock::time_point Start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count();
+}
+
+static bool ReadSource(const std::string& SourcePath, std::string& Contents)
 {
-	std::string SourcePath = "program.c";
 	std::ifstream ifs(SourcePath);
 
-	if (!ifs.is_open()) {
-		perror("ifstream error");
-		return 1;
+	if (!ifs.is_open())
+		return false;
+
+	Contents = std::string(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+	return true;
+}
+
+static void DumpTokens(const vector<Token>& Tokens, std::ostream& OS)
+{
+	OS << "tokens:" << endl;
+	int Depth = 0;
+	for (auto Token : Tokens)
+	{
+		if (Token.Var.Type != VarType::NONE)
+			OS << "[" << Token::GetName(Token.Type) << " " << Token.Var.ToString();
+		else
+			OS << "[" << Token::GetName(Token.Type);
+
+		OS << "] ";
+
+		if (Token.Type == TType::L_BRACE)
+		{
+			Depth++;
+			OS << std::endl;
+			for (int i = 0; i < Depth; i++)
+				OS << "\t";
+		}
+
+		if (Token.Type == TType::R_BRACE)
+		{
+			Depth--;
+			OS << std::endl;
+		}
+
+		if (Token.Type == TType::SEMICOLON)
+		{
+			OS << std::endl;
+			for (int i = 0; i < Depth; i++)
+				OS << "\t";
+		}
 	}
 
-	std::string Contents = std::string(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+	OS << endl << endl;
+}
 
+// Parses and type checks a translation unit. The tree refers to types owned by Checker.
+static PNode* ParseSource(const std::string& Contents, const DriverOptions& Options, std::ostream& OS,
+						  Sema& Checker, std::vector<Token>* Tokens = nullptr)
+{
 	Lexer Lexer(Contents);
 	Lexer.Tokenize();
 
 	string LexerErrorMsg;
 	if (Lexer.GetError(LexerErrorMsg))
-		std::cerr << "error: " << LexerErrorMsg << std::endl;
-	else {
-		cout << "tokens:" << endl;
-		int Depth = 0;
-		for (auto Token : Lexer.GetTokens())
-		{
-			if (Token.Var.Type != VarType::NONE)
-				std::cout << "[" << Token::GetName(Token.Type) << " " << Token.Var.ToString();
-			else
-				std::cout << "[" << Token::GetName(Token.Type);
-
-			// std::cout << " " << Token.Row << ", " << Token.Column << "] ";
-            std::cout << "] ";
-
-			if (Token.Type == TType::L_BRACE)
-			{
-				Depth++;
-				std::cout << std::endl;
-				for (int i = 0; i < Depth; i++)
-					std::cout << "\t";
-			}
+		throw CompileError(0, 0, "error: " + LexerErrorMsg);
+
+	if (Options.DumpTokens)
+		DumpTokens(Lexer.GetTokens(), OS);
+
+	if (Tokens)
+		*Tokens = Lexer.GetTokens();
+
+	Parser Parser(Lexer.GetTokens());
+	std::unique_ptr<PNode> Result(Parser.Parse());
+
+	if (Options.DumpAst)
+		OS << "ast:" << endl << Result->ToString() << endl << endl;
+
+	Checker.Check(Result.get());
+	if (!Options.SyntaxOnly) {
+		Folder Folder;
+		Folder.Run(Result.get());
+	}
+	return Result.release();
+}
+
+// Everything besides the source text that changes the object file produced for it
+static std::vector<std::string> GetCacheKeyOptions(const DriverOptions& Options, const Backend& Backend,
+													const std::string& SourcePath)
+{
+	std::vector<std::string> KeyOptions = { Backend.TargetTriple, "-O" + std::to_string(Options.OptLevel) };
+	if (Options.DirectSSA)
+		KeyOptions.push_back("-fssa");
+	if (Options.FastMath)
+		KeyOptions.push_back("-ffast-math");
+	if (Options.ProfileGenerate)
+		KeyOptions.push_back("-fprofile-generate");
+	if (Options.FunctionSections)
+		KeyOptions.push_back("-ffunction-sections");
+	// A new profile changes the weights without changing the command line
+	if (!Options.ProfileUse.empty()) {
+		auto Hash = sys::fs::md5_contents(Options.ProfileUse);
+		KeyOptions.push_back("-fprofile-use=" + (Hash ? Hash->digest().str().str() : Options.ProfileUse));
+	}
+	// Debug information names the file and the directory it was compiled in
+	if (Options.DebugInfo) {
+		KeyOptions.push_back(Options.LineTablesOnly ? "-gline-tables-only" : "-g");
+		SmallString<128> Directory;
+		sys::fs::current_path(Directory);
+		KeyOptions.push_back(SourcePath);
+		KeyOptions.push_back(Directory.str().str());
+	}
+	// LLVM options reach every pass and the code generator
+	for (const auto& Arg : Options.LLVMArgs)
+		KeyOptions.push_back("-mllvm=" + Arg);
+	return KeyOptions;
+}
+
+static bool HasRemarks(const DriverOptions& Options)
+{
+	return !Options.RemarksPassed.empty() || !Options.RemarksMissed.empty() || !Options.RemarksAnalysis.empty()
+		|| Options.SaveRemarks;
+}
+
+// Applies the code generation options to a generator before it runs
+static void ConfigureGenerator(Gen& Generator, const DriverOptions& Options)
+{
+	Generator.DirectSSA = Options.DirectSSA;
+	Generator.FastMath = Options.FastMath;
+	if (Options.DebugInfo)
+		Generator.DebugInfo = Options.LineTablesOnly ? DebugInfoKind::LINE_TABLES : DebugInfoKind::FULL;
+	// Remarks are located through the debug locations of the instructions
+	else if (HasRemarks(Options))
+		Generator.DebugInfo = DebugInfoKind::LOCATIONS;
+}
+
+static void ConfigureBackend(Backend& Backend, const DriverOptions& Options)
+{
+	Backend.RemarksPassed = Options.RemarksPassed;
+	Backend.RemarksMissed = Options.RemarksMissed;
+	Backend.RemarksAnalysis = Options.RemarksAnalysis;
+	Backend.ProfileGenerate = Options.ProfileGenerate;
+	Backend.ProfileUse = Options.ProfileUse;
+	Backend.FunctionSections = Options.FunctionSections || !Options.ProfileUse.empty();
+	Backend.SplitColdCode = !Options.ProfileUse.empty() && Options.OptLevel > 0;
+}
 
-			if (Token.Type == TType::R_BRACE)
-			{
-				Depth--;
-				std::cout << std::endl;
+// Compiles every function definition, and the file-scope variables together,
+// into objects of their own and reuses the cached object of each unit whose
+// fingerprint did not change. Returns false for a file without definitions,
+// which is compiled as a whole instead.
+static bool CompileFunctions(const DriverOptions& Options, Compilation& C, CompileCache& Cache,
+							 const std::string& Contents, std::ostream& Log)
+{
+	std::vector<Token> Tokens;
+	Sema Checker;
+	std::unique_ptr<PNode> Ast(ParseSource(Contents, Options, Log, Checker, &Tokens));
+	auto Units = CollectFunctionUnits(Tokens, Ast.get(), Options.DebugInfo);
+	if (Units.empty())
+		return false;
+
+	Backend Backend(Options.OptLevel);
+	ConfigureBackend(Backend, Options);
+	auto KeyOptions = GetCacheKeyOptions(Options, Backend, C.SourcePath);
+	KeyOptions.push_back("function");
+
+	std::vector<std::string> Keys;
+	std::vector<size_t> Stale;
+	C.Objects.clear();
+	for (size_t i = 0; i < Units.size(); i++) {
+		Keys.push_back(Cache.ComputeKey(Units[i].Fingerprint, KeyOptions));
+		C.Objects.push_back(C.ObjectPrefix + "." + std::to_string(i) + ".o");
+		if (!Cache.Lookup(Keys[i], C.Objects[i]))
+			Stale.push_back(i);
+	}
+
+	// Each stale unit is generated from the whole tree with the other definitions
+	// left out, so it sees exactly the declarations of a full build
+	std::vector<std::unique_ptr<Gen>> Generators;
+	for (size_t i = 0; i < Stale.size(); i++) {
+		auto& Unit = Units[Stale[i]];
+		Generators.push_back(std::make_unique<Gen>());
+		auto& Generator = *Generators.back();
+		ConfigureGenerator(Generator, Options);
+		Generator.DefinitionFilter = &Unit.Definitions;
+		Generator.MainModule->setModuleIdentifier(C.SourcePath + ":" + Unit.Name);
+		Generator.MainModule->setSourceFileName(C.SourcePath);
+		Generator.Generate(Ast.get());
+	}
+
+	// Generators own separate contexts, so a lone file spreads them over the threads
+	auto Emit = [&](size_t i) {
+		auto Index = Stale[i];
+		if (Backend.EmitObject(*Generators[i]->MainModule, C.Objects[Index]))
+			Cache.Store(Keys[Index], C.Objects[Index]);
+	};
+	if (Options.Jobs > 1 && Options.Sources.size() == 1) {
+		ThreadPool Pool(heavyweight_hardware_concurrency(Options.Jobs));
+		for (size_t i = 0; i < Stale.size(); i++)
+			Pool.async([&Emit, i] { Emit(i); });
+		Pool.wait();
+	} else {
+		for (size_t i = 0; i < Stale.size(); i++)
+			Emit(i);
+	}
+
+	string BackendErrorMsg;
+	if (Backend.GetError(BackendErrorMsg))
+		throw CompileError(0, 0, "error: " + BackendErrorMsg);
+
+	if (Options.CacheStats)
+		Log << C.SourcePath << ": recompiled " << Stale.size() << " of " << Units.size() << " units" << endl;
+	return true;
+}
+
+static void CompileFile(const DriverOptions& Options, Compilation& C, CompileCache* Cache)
+{
+	std::ostringstream Log;
+
+	try {
+		std::string Contents;
+		if (!ReadSource(C.SourcePath, Contents))
+			throw CompileError(0, 0, "error: cannot open file");
+
+		// A cached object comes without the remarks and profile counts of its compilation
+		bool Remarks = HasRemarks(Options) || !Options.SymbolOrderingFile.empty();
+		if (Options.Incremental && Cache && !Options.EmitLLVM && !Remarks
+			&& CompileFunctions(Options, C, *Cache, Contents, Log)) {
+			C.Log = Log.str();
+			return;
+		}
+
+		// Partitioned codegen yields several objects per file and is not cached. The
+		// thread count never changes the partitioning, only -fcodegen-units does.
+		bool Partitioned = Options.CodegenUnits > 1 && Options.Sources.size() == 1;
+		bool Cached = Cache && !Options.EmitLLVM && !Partitioned && !Remarks;
+
+		std::string CacheKey;
+		if (Cached) {
+			Backend Backend(Options.OptLevel);
+			CacheKey = Cache->ComputeKey(Contents, GetCacheKeyOptions(Options, Backend, C.SourcePath));
+			C.Objects = { C.ObjectPrefix + ".o" };
+			if (Cache->Lookup(CacheKey, C.Objects[0])) {
+				C.Log = Log.str();
+				return;
 			}
+		}
+
+		Sema Checker;
+		std::unique_ptr<PNode> Ast(ParseSource(Contents, Options, Log, Checker));
+
+		Gen Generator;
+		ConfigureGenerator(Generator, Options);
+		Generator.MainModule->setModuleIdentifier(C.SourcePath);
+		Generator.MainModule->setSourceFileName(C.SourcePath);
+		Generator.Generate(Ast.get());
 
-			if (Token.Type == TType::SEMICOLON)
-			{
-				std::cout << std::endl;
-				for (int i = 0; i < Depth; i++)
-					std::cout << "\t";
+		if (Options.EmitLLVM) {
+			Generator.Save(C.ObjectPrefix + ".ll");
+		} else {
+			Backend Backend(Options.OptLevel);
+			ConfigureBackend(Backend, Options);
+			// Partitions are lowered in contexts of their own, only the remarks of the
+			// whole module optimization are recorded for them
+			Backend.RemarksFile = C.RemarksFile;
+			bool Emitted;
+			// Partitions of a lone file are lowered on the threads, several files get one thread each
+			if (Partitioned)
+				Emitted = Backend.EmitObjects(*Generator.MainModule, Options.CodegenUnits, Options.Jobs,
+											  C.ObjectPrefix, C.Objects);
+			else {
+				C.Objects = { C.ObjectPrefix + ".o" };
+				Emitted = Backend.EmitObject(*Generator.MainModule, C.Objects[0]);
 			}
+			Log << Backend.GetRemarks();
+			C.FunctionCounts = Backend.GetFunctionCounts();
+
+			string BackendErrorMsg;
+			if (!Emitted && Backend.GetError(BackendErrorMsg))
+				throw CompileError(0, 0, "error: " + BackendErrorMsg);
+
+			if (Cached)
+				Cache->Store(CacheKey, C.Objects[0]);
 		}
+	} catch (const CompileError& Error) {
+		Log << C.SourcePath << ": " << Error.what() << endl;
+		C.Failed = true;
+	}
+
+	C.Log = Log.str();
+}
 
-		cout << endl;
-		cout << endl;
+// Generates every file on its own thread, then links the modules and lowers the
+// whole program at once into the objects of the first compilation. Nothing is
+// cached, every object depends on every file.
+static void CompileProgram(const DriverOptions& Options, std::vector<Compilation>& Compilations)
+{
+	// Generators own separate contexts, modules reach the shared one as bitcode
+	std::vector<std::string> Bitcode(Compilations.size());
+	auto Generate = [&](size_t i) {
+		auto& C = Compilations[i];
+		std::ostringstream Log;
+		try {
+			std::string Contents;
+			if (!ReadSource(C.SourcePath, Contents))
+				throw CompileError(0, 0, "error: cannot open file");
 
-		Parser Parser(Lexer.GetTokens());
-		PNode* Result = Parser.Parse();
-		cout << "ast:" << endl;
-		cout << Result->ToString() << endl;
+			Sema Checker;
+			std::unique_ptr<PNode> Ast(ParseSource(Contents, Options, Log, Checker));
 
-		cout << endl << "ir code:" << endl;
-		Gen Generator;
-		Generator.Generate(Result);
-		Generator.Save("out.ll");
+			Gen Generator;
+			ConfigureGenerator(Generator, Options);
+			Generator.MainModule->setModuleIdentifier(C.SourcePath);
+			Generator.MainModule->setSourceFileName(C.SourcePath);
+			Generator.Generate(Ast.get());
+
+			raw_string_ostream OS(Bitcode[i]);
+			WriteBitcodeToFile(*Generator.MainModule, OS);
+		} catch (const CompileError& Error) {
+			Log << C.SourcePath << ": " << Error.what() << endl;
+			C.Failed = true;
+		}
+		C.Log = Log.str();
+	};
+	ThreadPool Pool(heavyweight_hardware_concurrency(Options.Jobs));
+	for (size_t i = 0; i < Compilations.size(); i++)
+		Pool.async([&Generate, i] { Generate(i); });
+	Pool.wait();
+
+	for (const auto& C : Compilations)
+		if (C.Failed)
+			return;
+
+	LLVMContext Context;
+#if LLVM_VERSION_MAJOR < 15
+	Context.enableOpaquePointers();
+#endif
+	auto& Program = Compilations[0];
+	std::vector<std::unique_ptr<Module>> Modules;
+	for (size_t i = 0; i < Compilations.size(); i++) {
+		auto M = parseBitcodeFile(MemoryBufferRef(Bitcode[i], Compilations[i].SourcePath), Context);
+		if (!M) {
+			Program.Log += "error: " + toString(M.takeError()) + "\n";
+			Program.Failed = true;
+			return;
+		}
+		Modules.push_back(std::move(*M));
+	}
+
+	Backend Backend(Options.OptLevel);
+	ConfigureBackend(Backend, Options);
+	Backend.RemarksFile = Program.RemarksFile;
+	bool Emitted = false;
+	if (auto Linked = Backend.LinkProgram(std::move(Modules), Options.ExportedSymbols)) {
+		if (Options.CodegenUnits > 1)
+			Emitted = Backend.EmitObjects(*Linked, Options.CodegenUnits, Options.Jobs, Program.ObjectPrefix,
+										  Program.Objects);
+		else {
+			Program.Objects = { Program.ObjectPrefix + ".o" };
+			Emitted = Backend.EmitObject(*Linked, Program.Objects[0]);
+		}
+	}
+	Program.Log += Backend.GetRemarks();
+	Program.FunctionCounts = Backend.GetFunctionCounts();
+
+	string BackendErrorMsg;
+	if (!Emitted && Backend.GetError(BackendErrorMsg)) {
+		Program.Log += "error: " + BackendErrorMsg + "\n";
+		Program.Failed = true;
+	}
+}
+
+// Measures time from source text to the return of `main` for the interpreter
+// and for the LLVM path (IR generation plus MCJIT) in the same process.
+static int RunBenchmark(const std::string& Contents, const DriverOptions& Options)
+{
+	cout << "run (interpreter):" << endl;
+	auto InterpStart = std::chrono::steady_clock::now();
+	Sema InterpChecker;
+	std::unique_ptr<PNode> InterpAst(ParseSource(Contents, Options, cout, InterpChecker));
+	Interp Interpreter;
+	int InterpExit = Interpreter.Run(InterpAst.get());
+	fflush(stdout);
+	double InterpMs = MillisecondsSince(InterpStart);
 
-        cout << endl << "clang:" << endl;
-        system("clang -O0 out.ll");
+	cout << endl << "run (llvm jit):" << endl;
+	auto GenStart = std::chrono::steady_clock::now();
+	Sema GenChecker;
+	std::unique_ptr<PNode> GenAst(ParseSource(Contents, Options, cout, GenChecker));
+	Gen Generator;
+	ConfigureGenerator(Generator, Options);
+	Generator.Generate(GenAst.get());
+	double GenMs = MillisecondsSince(GenStart);
 
-        //system("clang -S -emit-llvm -O0 -o out_O0.ll out.ll");
-        //system("clang -S -emit-llvm -O1 -o out_O1.ll out.ll");
+	auto JitStart = std::chrono::steady_clock::now();
+	InitializeNativeTarget();
+	InitializeNativeTargetAsmPrinter();
 
-        cout << endl << "run:" << endl;
-        system("./a.out");
+	// The engine takes the module over from the generator
+	std::string EngineError;
+	ExecutionEngine* Engine = EngineBuilder(std::unique_ptr<Module>(Generator.MainModule))
+		.setErrorStr(&EngineError)
+		.setEngineKind(EngineKind::JIT)
+		.create();
+	Generator.MainModule = nullptr;
+	if (!Engine) {
+		std::cerr << "error: " << EngineError << std::endl;
+		return 1;
+	}
+	Engine->finalizeObject();
+	auto MainFunc = (int (*)()) Engine->getFunctionAddress("main");
+	double JitMs = MillisecondsSince(JitStart);
+	if (!MainFunc) {
+		std::cerr << "error: no `main` function defined" << std::endl;
+		return 1;
 	}
 
+	auto RunStart = std::chrono::steady_clock::now();
+	int JitExit = MainFunc();
+	fflush(stdout);
+	double RunMs = MillisecondsSince(RunStart);
+	delete Engine;
+
+	cout << endl << "bench:" << endl;
+	cout << "interpreter: " << InterpMs << " ms (exit " << InterpExit << ")" << endl;
+	cout << "llvm jit:    " << GenMs + JitMs + RunMs << " ms (exit " << JitExit << "; gen " << GenMs
+		 << " ms, jit " << JitMs << " ms, run " << RunMs << " ms)" << endl;
 	return 0;
+}
+
+static bool ParseArguments(int argc, char** argv, DriverOptions& Options)
+{
+	for (int i = 1; i < argc; i++) {
+		std::string Arg = argv[i];
+		if (Arg == "-help" || Arg == "--help") {
+			cout << Usage;
+			exit(0);
+		} else if (Arg == "-o" && i + 1 < argc)
+			Options.OutputPath = argv[++i];
+		else if (Arg == "-c")
+			Options.CompileOnly = true;
+		else if (Arg == "-emit-llvm")
+			Options.EmitLLVM = true;
+		else if (Arg == "-run")
+			Options.Run = true;
+		else if (Arg == "-interpret")
+			Options.Interpret = true;
+		else if (Arg == "-bench")
+			Options.Bench = true;
+		else if (Arg == "-dump-tokens")
+			Options.DumpTokens = true;
+		else if (Arg == "-dump-ast")
+			Options.DumpAst = true;
+		else if (Arg == "-fsyntax-only")
+			Options.SyntaxOnly = true;
+		else if (Arg.size() == 3 && Arg.rfind("-O", 0) == 0 && isdigit(Arg[2]))
+			Options.OptLevel = std::min(3, Arg[2] - '0');
+		else if (Arg == "-j" && i + 1 < argc)
+			Options.Jobs = std::max(1, atoi(argv[++i]));
+		else if (Arg.rfind("-j", 0) == 0 && Arg.size() > 2)
+			Options.Jobs = std::max(1, atoi(Arg.c_str() + 2));
+		else if (Arg.rfind("-fcodegen-units=", 0) == 0)
+			Options.CodegenUnits = std::max(1, atoi(Arg.c_str() + 16));
+		else if (Arg.rfind("-fcache-dir=", 0) == 0)
+			Options.CacheDir = Arg.substr(12);
+		else if (Arg.rfind("-fcache-size=", 0) == 0)
+			Options.CacheSizeMB = strtoull(Arg.c_str() + 13, nullptr, 10);
+		else if (Arg == "-cache-stats")
+			Options.CacheStats = true;
+		else if (Arg == "-fincremental")
+			Options.Incremental = true;
+		else if (Arg == "-fssa")
+			Options.DirectSSA = true;
+		else if (Arg == "-ffast-math")
+			Options.FastMath = true;
+		else if (Arg == "-g") {
+			Options.DebugInfo = true;
+			Options.LineTablesOnly = false;
+		} else if (Arg == "-gline-tables-only") {
+			Options.DebugInfo = true;
+			Options.LineTablesOnly = true;
+		} else if (Arg == "-g0")
+			Options.DebugInfo = false;
+		else if (Arg == "-fprofile-generate")
+			Options.ProfileGenerate = true;
+		else if (Arg.rfind("-fprofile-use=", 0) == 0)
+			Options.ProfileUse = Arg.substr(14);
+		else if (Arg == "-ffunction-sections")
+			Options.FunctionSections = true;
+		else if (Arg.rfind("-fsymbol-ordering-file=", 0) == 0)
+			Options.SymbolOrderingFile = Arg.substr(23);
+		else if (Arg == "-flto")
+			Options.WholeProgram = true;
+		else if (Arg.rfind("-exported-symbol=", 0) == 0)
+			Options.ExportedSymbols.insert(Arg.substr(17));
+		else if (Arg.rfind("-Rpass=", 0) == 0)
+			Options.RemarksPassed = Arg.substr(7);
+		else if (Arg.rfind("-Rpass-missed=", 0) == 0)
+			Options.RemarksMissed = Arg.substr(14);
+		else if (Arg.rfind("-Rpass-analysis=", 0) == 0)
+			Options.RemarksAnalysis = Arg.substr(16);
+		else if (Arg == "-fsave-optimization-record")
+			Options.SaveRemarks = true;
+		else if (Arg.rfind("-foptimization-record-file=", 0) == 0) {
+			Options.RemarksFile = Arg.substr(27);
+			Options.SaveRemarks = true;
+		} else if (Arg == "-mllvm" && i + 1 < argc)
+			Options.LLVMArgs.push_back(argv[++i]);
+		else if (Arg.size() > 1 && Arg[0] == '-') {
+			std::cerr << "error: unknown argument `" << Arg << "`" << std::endl << Usage;
+			return false;
+		} else
+			Options.Sources.push_back(Arg);
+	}
+
+	if (Options.CacheDir.empty() && getenv("CCOMP_CACHE_DIR"))
+		Options.CacheDir = getenv("CCOMP_CACHE_DIR");
+
+	if (Options.Sources.empty()) {
+		std::cerr << "error: no input files" << std::endl << Usage;
+		return false;
+	}
+
+	if (Options.Incremental && Options.CacheDir.empty()) {
+		std::cerr << "error: -fincremental needs -fcache-dir or CCOMP_CACHE_DIR" << std::endl;
+		return false;
+	}
+
+	for (const auto& Pattern : { Options.RemarksPassed, Options.RemarksMissed, Options.RemarksAnalysis }) {
+		std::string RegexError;
+		if (!Pattern.empty() && !Regex(Pattern).isValid(RegexError)) {
+			std::cerr << "error: invalid remark pattern `" << Pattern << "`: " << RegexError << std::endl;
+			return false;
+		}
+	}
+
+	if (Options.ProfileGenerate && !Options.ProfileUse.empty()) {
+		std::cerr << "error: -fprofile-generate and -fprofile-use cannot be combined" << std::endl;
+		return false;
+	}
+
+	if (!Options.ProfileUse.empty() && !sys::fs::exists(Options.ProfileUse)) {
+		std::cerr << "error: cannot open profile `" << Options.ProfileUse << "`" << std::endl;
+		return false;
+	}
+
+	if (Options.WholeProgram && (Options.CompileOnly || Options.EmitLLVM)) {
+		std::cerr << "error: -flto links the program and cannot be combined with -c or -emit-llvm" << std::endl;
+		return false;
+	}
+
+	if (!Options.SymbolOrderingFile.empty() && Options.ProfileUse.empty()) {
+		std::cerr << "error: -fsymbol-ordering-file needs -fprofile-use" << std::endl;
+		return false;
+	}
+
+	if (!Options.RemarksFile.empty() && Options.Sources.size() != 1) {
+		std::cerr << "error: -foptimization-record-file takes exactly one input file" << std::endl;
+		return false;
+	}
+
+	if ((Options.Interpret || Options.Bench) && Options.Sources.size() != 1) {
+		std::cerr << "error: -interpret and -bench take exactly one input file" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Writes the functions of every file the profile ran, hottest first
+static bool WriteSymbolOrdering(const DriverOptions& Options, const std::vector<Compilation>& Compilations)
+{
+	std::vector<std::pair<std::string, uint64_t>> Counts;
+	for (const auto& C : Compilations)
+		Counts.insert(Counts.end(), C.FunctionCounts.begin(), C.FunctionCounts.end());
+	std::stable_sort(Counts.begin(), Counts.end(), [](const auto& A, const auto& B) { return A.second > B.second; });
+
+	std::ofstream Out(Options.SymbolOrderingFile);
+	for (const auto& Count : Counts)
+		Out << Count.first << "\n";
+	if (!Out) {
+		std::cerr << "error: cannot write `" << Options.SymbolOrderingFile << "`" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+static int RunCommand(const std::string& Command)
+{
+	int Status = system(Command.c_str());
+	if (Status != 0)
+		std::cerr << "error: command failed: " << Command << std::endl;
+	return Status;
+}
+
+int main(int argc, char** argv)
+{
+	DriverOptions Options;
+	if (!ParseArguments(argc, argv, Options))
+		return 1;
+
+	if (!Options.LLVMArgs.empty()) {
+		std::vector<const char*> Args = { argv[0] };
+		for (const auto& Arg : Options.LLVMArgs)
+			Args.push_back(Arg.c_str());
+		cl::ParseCommandLineOptions(Args.size(), Args.data(), "ccomp");
+	}
+
+	if (Options.Interpret || Options.Bench) {
+		std::string Contents;
+		if (!ReadSource(Options.Sources[0], Contents)) {
+			perror("ifstream error");
+			return 1;
+		}
+
+		try {
+			if (Options.Bench)
+				return RunBenchmark(Contents, Options);
+
+			// Interpreting never touches LLVM, so tiny programs start instantly
+			Sema Checker;
+			std::unique_ptr<PNode> Result(ParseSource(Contents, Options, cout, Checker));
+			Interp Interpreter;
+			return Interpreter.Run(Result.get());
+		} catch (const CompileError& Error) {
+			std::cerr << Options.Sources[0] << ": " << Error.what() << std::endl;
+			return 1;
+		}
+	}
+
+	// Errors are reported without creating any LLVM state, cache entries or objects
+	if (Options.SyntaxOnly) {
+		int Status = 0;
+		for (const auto& SourcePath : Options.Sources) {
+			try {
+				std::string Contents;
+				if (!ReadSource(SourcePath, Contents))
+					throw CompileError(0, 0, "error: cannot open file");
+				Sema Checker;
+				std::unique_ptr<PNode> Ast(ParseSource(Contents, Options, cout, Checker));
+			} catch (const CompileError& Error) {
+				std::cerr << SourcePath << ": " << Error.what() << std::endl;
+				Status = 1;
+			}
+		}
+		return Status;
+	}
+
+	std::unique_ptr<CompileCache> Cache;
+	if (!Options.CacheDir.empty()) {
+		Cache = std::make_unique<CompileCache>(Options.CacheDir, Options.CacheSizeMB << 20);
+		std::string CacheErrorMsg;
+		if (!Cache->Init(CacheErrorMsg)) {
+			std::cerr << "error: " << CacheErrorMsg << std::endl;
+			return 1;
+		}
+	}
+
+	bool Link = !Options.CompileOnly && !Options.EmitLLVM;
+
+	SmallString<128> TempDir;
+	if (Link) {
+		if (auto EC = sys::fs::createUniqueDirectory("ccomp", TempDir)) {
+			std::cerr << "error: cannot create temporary directory: " << EC.message() << std::endl;
+			return 1;
+		}
+	}
+
+	std::vector<Compilation> Compilations(Options.Sources.size());
+	for (size_t i = 0; i < Options.Sources.size(); i++) {
+		auto& C = Compilations[i];
+		C.SourcePath = Options.Sources[i];
+
+		auto Stem = sys::path::stem(C.SourcePath).str();
+		if (Link)
+			C.ObjectPrefix = (TempDir + "/" + std::to_string(i) + "-" + Stem).str();
+		else if (!Options.OutputPath.empty() && Options.Sources.size() == 1) {
+			SmallString<128> OutputPrefix(Options.OutputPath);
+			sys::path::replace_extension(OutputPrefix, "");
+			C.ObjectPrefix = OutputPrefix.str().str();
+		} else
+			C.ObjectPrefix = Stem;
+
+		// The record of a linked program stays in the working directory
+		if (!Options.RemarksFile.empty())
+			C.RemarksFile = Options.RemarksFile;
+		else if (Options.SaveRemarks)
+			C.RemarksFile = (Link ? Stem : C.ObjectPrefix) + ".opt.yaml";
+	}
+
+	// Largest files are queued first so one big file does not finish last on its own
+	std::vector<size_t> Order(Compilations.size());
+	std::vector<uint64_t> Sizes(Compilations.size(), 0);
+	for (size_t i = 0; i < Order.size(); i++) {
+		Order[i] = i;
+		sys::fs::file_size(Compilations[i].SourcePath, Sizes[i]);
+	}
+	std::stable_sort(Order.begin(), Order.end(), [&](size_t A, size_t B) { return Sizes[A] > Sizes[B]; });
+
+	if (Options.WholeProgram)
+		CompileProgram(Options, Compilations);
+	else if (Options.Sources.size() == 1)
+		CompileFile(Options, Compilations[0], Cache.get());
+	else {
+		ThreadPool Pool(heavyweight_hardware_concurrency(Options.Jobs));
+		for (auto i : Order)
+			Pool.async([&Options, &Compilations, &Cache, i] { CompileFile(Options, Compilations[i], Cache.get()); });
+		Pool.wait();
+	}
+
+	// Logs are printed in command line order regardless of completion order
+	bool Failed = false;
+	for (const auto& C : Compilations) {
+		cout << C.Log;
+		Failed |= C.Failed;
+	}
+
+	if (Cache) {
+		Cache->Prune();
+		if (Options.CacheStats)
+			Cache->ReportStats(cout);
+	}
+
+	int Status = Failed ? 1 : 0;
+
+	if (!Failed && !Options.SymbolOrderingFile.empty() && !WriteSymbolOrdering(Options, Compilations))
+		Status = 1;
+
+	if (!Failed && Options.CompileOnly) {
+		// Partitioned or per-function objects of a file are merged into one relocatable object
+		for (const auto& C : Compilations) {
+			if (C.Objects.size() == 1 && C.Objects[0] == C.ObjectPrefix + ".o")
+				continue;
+			std::string MergeCommand = "clang -r -o " + C.ObjectPrefix + ".o";
+			for (const auto& Object : C.Objects)
+				MergeCommand += " " + Object;
+			if (RunCommand(MergeCommand))
+				Status = 1;
+			for (const auto& Object : C.Objects)
+				sys::fs::remove(Object);
+		}
+	}
+
+	if (!Failed && Link) {
+		std::string OutputPath = Options.OutputPath.empty() ? "a.out" : Options.OutputPath;
+		std::string LinkCommand = "clang -o " + OutputPath;
+		// The driver links the profile runtime the counters are written by
+		if (Options.ProfileGenerate)
+			LinkCommand += " -fprofile-generate";
+		for (const auto& C : Compilations)
+			for (const auto& Object : C.Objects)
+				LinkCommand += " " + Object;
+		Status = RunCommand(LinkCommand) ? 1 : 0;
+
+		if (!Status && Options.Run)
+			system((sys::path::has_parent_path(OutputPath) ? OutputPath : "./" + OutputPath).c_str());
+	}
+
+	if (Link) {
+		for (const auto& C : Compilations)
+			for (const auto& Object : C.Objects)
+				sys::fs::remove(Object);
+		sys::fs::remove(TempDir);
+	}
+
+	return Status;
 }
\ No newline at end of file
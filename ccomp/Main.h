@@ -2,3 +2,63 @@
 
 #include <iostream>
 #include <fstream>
+#include <set>
+#include <string>
+#include <vector>
+
+class DriverOptions {
+public:
+	std::vector<std::string> Sources;
+	std::vector<std::string> LLVMArgs;
+	// Symbols -flto keeps visible besides main
+	std::set<std::string> ExportedSymbols;
+	std::string OutputPath;
+	std::string CacheDir;
+	// Pass name patterns of the reported optimization remarks
+	std::string RemarksPassed;
+	std::string RemarksMissed;
+	std::string RemarksAnalysis;
+	std::string RemarksFile;
+	bool SaveRemarks = false;
+	// Indexed profile of -fprofile-use=
+	std::string ProfileUse;
+	bool ProfileGenerate = false;
+	// Hot functions of the profile, hottest first, for the linker to place together
+	std::string SymbolOrderingFile;
+	bool FunctionSections = false;
+	bool WholeProgram = false;
+	uint64_t CacheSizeMB = 1024;
+	unsigned OptLevel = 0;
+	unsigned Jobs = 1;
+	unsigned CodegenUnits = 1;
+	bool Interpret = false;
+	bool Bench = false;
+	bool CompileOnly = false;
+	bool EmitLLVM = false;
+	bool Run = false;
+	bool DumpTokens = false;
+	bool DumpAst = false;
+	bool CacheStats = false;
+	bool Incremental = false;
+	bool DirectSSA = false;
+	bool FastMath = false;
+	// -g and -gline-tables-only, the latter without types and variables
+	bool DebugInfo = false;
+	bool LineTablesOnly = false;
+	bool SyntaxOnly = false;
+};
+
+// One translation unit. Each one owns its Lexer, Parser, Gen and LLVMContext,
+// so compilations run concurrently without sharing mutable state.
+class Compilation {
+public:
+	std::string SourcePath;
+	std::string ObjectPrefix;
+	std::vector<std::string> Objects;
+	// YAML optimization record, empty when none is written
+	std::string RemarksFile;
+	// Profile entry counts of the functions in Objects
+	std::vector<std::pair<std::string, uint64_t>> FunctionCounts;
+	std::string Log;
+	bool Failed = false;
+};
@@ -7,13 +7,18 @@ static std::string Indent(int depth) {
     return Res;
 }
 
-static std::string GetType(std::string Name, size_t PtrDepth, PNode *ArrayExpr) {
+static std::string GetType(std::string Name, size_t PtrDepth, PNode *ArrayExpr, unsigned ConstLevels = 0) {
     std::string Res;
+    if (ConstLevels & 1)
+        Res += "const ";
     Res += Name;
     if (PtrDepth)
         Res += " ";
-    for (int i = 0; i < PtrDepth; i++)
+    for (size_t i = 0; i < PtrDepth; i++) {
         Res += "*";
+        if (ConstLevels >> (i + 1) & 1)
+            Res += i + 1 < PtrDepth ? " const " : " const";
+    }
     if (ArrayExpr)
         Res += " (array of " + ArrayExpr->ToString(0) + ")";
     return Res;
@@ -25,6 +30,14 @@ std::string PNode::ToString(int Depth) {
     return std::string();
 }
 
+std::vector<PNode *> PNode::GetChildren() {
+    return {};
+}
+
+PNode *PNode::Fold(Folder *) {
+    return this;
+}
+
 IdentifierNode::IdentifierNode(std::string Name, PNode *IndexExpr) : Name(std::move(Name)), IndexExpr(IndexExpr) {
 
 }
@@ -33,6 +46,12 @@ std::string IdentifierNode::ToString(int Depth) {
     return Indent(Depth) + "id " + std::string(Name);
 }
 
+std::vector<PNode *> IdentifierNode::GetChildren() {
+    if (IndexExpr)
+        return {IndexExpr};
+    return {};
+}
+
 IntegerNode::IntegerNode(uint64_t Value, size_t NumBits) : Value(Value), NumBits(NumBits) {
 }
 
@@ -64,6 +83,10 @@ BinOpNode::~BinOpNode() {
 std::string BinOpNode::ToString(int Depth) {return Indent(Depth) + "bin op " + Token::GetName(OpType) + "\n" + LHS->ToString(Depth + 1) + "\n" + RHS->ToString(Depth + 1);
 }
 
+std::vector<PNode *> BinOpNode::GetChildren() {
+    return {LHS, RHS};
+}
+
 
 UnOpNode::UnOpNode(TType OpType, PNode *Expr) : OpType(OpType), Expr(Expr) {}
 
@@ -76,6 +99,10 @@ std::string UnOpNode::ToString(int Depth) {
     return Indent(Depth) + Token::GetName(OpType) + "\n" + Expr->ToString(Depth + 1);
 }
 
+std::vector<PNode *> UnOpNode::GetChildren() {
+    return {Expr};
+}
+
 AssignNode::AssignNode(IdentifierNode *Ident, PNode *Expr) : Alloc(nullptr), Ident(Ident), Expr(Expr) {}
 
 AssignNode::AssignNode(AllocNode *Alloc, PNode *Expr) : Alloc(Alloc), Ident(nullptr), Expr(Expr) {}
@@ -92,6 +119,28 @@ std::string AssignNode::ToString(int Depth) {
         return Indent(Depth) + "assign " + Ident->Name + "\n" + Expr->ToString(Depth + 1);
 }
 
+std::vector<PNode *> AssignNode::GetChildren() {
+    if (Alloc)
+        return {Alloc, Expr};
+    return {Ident, Expr};
+}
+
+InitListNode::~InitListNode() {
+    for (auto Element: Elements)
+        delete Element;
+}
+
+std::string InitListNode::ToString(int Depth) {
+    std::string Res = Indent(Depth) + "init list";
+    for (auto Element: Elements)
+        Res += '\n' + Element->ToString(Depth + 1);
+    return Res;
+}
+
+std::vector<PNode *> InitListNode::GetChildren() {
+    return Elements;
+}
+
 
 AllocNode::AllocNode(std::string AllocTypeName, std::string Name, size_t PtrDepth, PNode *ArraySizeExpr)
         : AllocTypeName(std::move(AllocTypeName)), Name(std::move(Name)), PtrDepth(PtrDepth), ArraySizeExpr(ArraySizeExpr) {
@@ -101,8 +150,22 @@ std::string AllocNode::ToString(int Depth) {
     return Indent(Depth) + "alloc " + ToTypeString();
 }
 
+std::vector<PNode *> AllocNode::GetChildren() {
+    if (ArraySizeExpr)
+        return {ArraySizeExpr};
+    return {};
+}
+
 std::string AllocNode::ToTypeString() {
-    return GetType(AllocTypeName, PtrDepth, ArraySizeExpr);
+    return GetType(AllocTypeName, PtrDepth, ArraySizeExpr, ConstLevels) + (IsRestrict ? " restrict" : "");
+}
+
+bool AllocNode::IsConst() const {
+    return ConstLevels >> PtrDepth & 1;
+}
+
+bool AllocNode::IsPointeeConst() const {
+    return PtrDepth && (ConstLevels >> (PtrDepth - 1) & 1);
 }
 
 AllocNode::~AllocNode() {
@@ -120,6 +183,10 @@ std::string StructNode::ToString(int Depth) {
     return Res;
 }
 
+std::vector<PNode *> StructNode::GetChildren() {
+    return {AllocNodes.begin(), AllocNodes.end()};
+}
+
 StructNode::~StructNode() {
 
 }
@@ -132,6 +199,10 @@ std::string TypedefNode::ToString(int Depth) {
     return Indent(Depth) + "typedef " + Alloc->ToTypeString() + " as " + Alloc->Name;
 }
 
+std::vector<PNode *> TypedefNode::GetChildren() {
+    return {Alloc};
+}
+
 TypedefNode::~TypedefNode() {
 
 }
@@ -151,6 +222,10 @@ std::string BlockNode::ToString(int Depth) {
     return Res;
 }
 
+std::vector<PNode *> BlockNode::GetChildren() {
+    return Nodes;
+}
+
 IfNode::IfNode(PNode *CondExpr, PNode *BodyExpr, PNode *ElseBrExpr) : CondExpr(CondExpr), BodyExpr(BodyExpr),
                                                                       ElseBrExpr(ElseBrExpr) {}
 
@@ -162,6 +237,8 @@ IfNode::~IfNode() {
 
 std::string IfNode::ToString(int Depth) {
     std::string Res = Indent(Depth) + "if";
+    if (Likelihood)
+        Res += Likelihood > 0 ? " likely" : " unlikely";
     Res += '\n' + CondExpr->ToString(Depth + 1);
     Res += '\n' + BodyExpr->ToString(Depth + 1);
     if (ElseBrExpr != nullptr)
@@ -169,6 +246,12 @@ std::string IfNode::ToString(int Depth) {
     return Res;
 }
 
+std::vector<PNode *> IfNode::GetChildren() {
+    if (ElseBrExpr)
+        return {CondExpr, BodyExpr, ElseBrExpr};
+    return {CondExpr, BodyExpr};
+}
+
 
 RefNode::RefNode(PNode *Expr, bool IsDeref, int Depth) : Expr(Expr), IsDeref(IsDeref), Depth(Depth) {}
 
@@ -187,6 +270,10 @@ std::string RefNode::ToString(int Depth) {
     return Res;
 }
 
+std::vector<PNode *> RefNode::GetChildren() {
+    return {Expr};
+}
+
 CallNode::CallNode(std::string CalleeName) : CalleeName(std::move(CalleeName)) {}
 
 CallNode::~CallNode() {
@@ -194,6 +281,10 @@ CallNode::~CallNode() {
         delete ArgExpr;
 }
 
+bool CallNode::IsBuiltinExpect() const {
+    return CalleeName == "__builtin_expect";
+}
+
 std::string CallNode::ToString(int Depth) {
     std::string Res = Indent(Depth) + "call " + CalleeName;
     for (auto i: ArgExprs)
@@ -201,6 +292,10 @@ std::string CallNode::ToString(int Depth) {
     return Res;
 }
 
+std::vector<PNode *> CallNode::GetChildren() {
+    return ArgExprs;
+}
+
 PrototypeNode::PrototypeNode(AllocNode *Type, std::string Name, std::vector<AllocNode *> Params, bool IsVarArg,
                              PNode *BodyExpr) : ReturnAllocNode(Type), Name(std::move(Name)), Params(std::move(Params)),
                                                 IsVarArg(IsVarArg), BodyExpr(BodyExpr) {}
@@ -208,7 +303,8 @@ PrototypeNode::PrototypeNode(AllocNode *Type, std::string Name, std::vector<Allo
 PrototypeNode::~PrototypeNode() {}
 
 std::string PrototypeNode::ToString(int Depth) {
-    std::string Res = Indent(Depth) + ReturnAllocNode->ToTypeString() + " " + Name + " (";
+    std::string Res = Indent(Depth) + (IsStatic ? "static " : "") + (IsInline ? "inline " : "")
+                      + ReturnAllocNode->ToTypeString() + " " + Name + " (";
     for (const auto &Pair: Params)
         Res += Pair->ToString(0) + ", ";
     Res += ")";
@@ -217,6 +313,14 @@ std::string PrototypeNode::ToString(int Depth) {
     return Res;
 }
 
+std::vector<PNode *> PrototypeNode::GetChildren() {
+    std::vector<PNode *> Children = {ReturnAllocNode};
+    Children.insert(Children.end(), Params.begin(), Params.end());
+    if (BodyExpr)
+        Children.push_back(BodyExpr);
+    return Children;
+}
+
 ReturnNode::ReturnNode(PNode *Expr) : Expr(Expr) {
 
 }
@@ -232,6 +336,12 @@ std::string ReturnNode::ToString(int Depth) {
         return Indent(Depth) + "return void";
 }
 
+std::vector<PNode *> ReturnNode::GetChildren() {
+    if (Expr)
+        return {Expr};
+    return {};
+}
+
 ForNode::ForNode(PNode *InitExpr, PNode *CondExpr, PNode *UpdateExpr, PNode *BodyExpr) : InitExpr(InitExpr),
                                                                                          CondExpr(CondExpr),
                                                                                          UpdateExpr(UpdateExpr),
@@ -246,8 +356,21 @@ ForNode::~ForNode() {
     delete BodyExpr;
 }
 
+bool LoopHints::Empty() const {
+    return !UnrollCount && !UnrollFull && !Vectorize && !Distribute;
+}
+
 std::string ForNode::ToString(int Depth) {
     std::string result = Indent(Depth) + "for ";
+    if (Hints.UnrollFull)
+        result += "unroll ";
+    else if (Hints.UnrollCount)
+        result += "unroll(" + std::to_string(Hints.UnrollCount) + ") ";
+    if (Hints.Vectorize)
+        result += Hints.VectorizeWidth ? "vectorize width(" + std::to_string(Hints.VectorizeWidth) + ") "
+                                       : Hints.Vectorize > 0 ? "vectorize(enable) " : "vectorize(disable) ";
+    if (Hints.Distribute)
+        result += "distribute ";
     if (InitExpr)
         result += "\n" + InitExpr->ToString(Depth + 1);
     if (CondExpr)
@@ -256,4 +379,12 @@ std::string ForNode::ToString(int Depth) {
         result += "\n" + UpdateExpr->ToString(Depth + 1);
     result += "\n" + BodyExpr->ToString(Depth + 1);
     return result;
-}
\ No newline at end of file
+}
+
+std::vector<PNode *> ForNode::GetChildren() {
+    std::vector<PNode *> Children;
+    for (auto Child: {InitExpr, CondExpr, UpdateExpr, BodyExpr})
+        if (Child)
+            Children.push_back(Child);
+    return Children;
+}
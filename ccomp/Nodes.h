@@ -12,16 +12,47 @@
 #include "llvm/IR/Constants.h"
 #include "Token.h"
 
+#include <set>
+
 class Gen;
 
+class Interp;
+
+class IValue;
+
+class PrototypeNode;
+
+class Sema;
+
+class CType;
+
+class Folder;
+
 class PNode {
 public:
     size_t Row, Column;
+    // Token index range of a statement, set by the parser for statements only
+    size_t FirstToken = 0, LastToken = 0;
+    // Set by Sema
+    CType *Type = nullptr;
+    // Functions run at compile time to fold calls in a top-level statement, set by Folder
+    std::set<std::string> EvaluatedFunctions;
+    // Const globals whose values were folded into a top-level statement, set by Folder
+    std::set<std::string> FoldedGlobals;
+
+    virtual CType *Check(Sema *S) = 0;
 
     virtual llvm::Value *Emit(Gen *G) = 0;
 
+    virtual IValue Eval(Interp *I) = 0;
+
     virtual std::string ToString(int Depth = 0);
 
+    virtual std::vector<PNode *> GetChildren();
+
+    // Returns the node that replaces this one after folding
+    virtual PNode *Fold(Folder *F);
+
     virtual ~PNode();
 };
 
@@ -32,9 +63,17 @@ public:
 
     IdentifierNode(std::string Name, PNode *IndexExpr);
 
+    CType *Check(Sema *S);
+
     llvm::Value *Emit(Gen *G);
 
+    IValue Eval(Interp *I);
+
     std::string ToString(int Depth = 0);
+
+    std::vector<PNode *> GetChildren();
+
+    PNode *Fold(Folder *F);
 };
 
 class IntegerNode : public PNode {
@@ -44,8 +83,12 @@ public:
 
     IntegerNode(uint64_t Value, size_t NumBits);
 
+    CType *Check(Sema *S);
+
     llvm::Value *Emit(Gen *G);
 
+    IValue Eval(Interp *I);
+
     std::string ToString(int Depth = 0);
 };
 
@@ -55,8 +98,12 @@ public:
 
     FloatNode(double Value);
 
+    CType *Check(Sema *S);
+
     llvm::Value *Emit(Gen *G);
 
+    IValue Eval(Interp *I);
+
     std::string ToString(int Depth = 0);
 };
 
@@ -66,8 +113,12 @@ public:
 
     StringNode(std::string Text);
 
+    CType *Check(Sema *S);
+
     llvm::Value *Emit(Gen *G);
 
+    IValue Eval(Interp *I);
+
     std::string ToString(int Depth = 0);
 };
 
@@ -76,14 +127,24 @@ public:
     TType OpType;
     PNode *LHS;
     PNode *RHS;
+    // Type both operands are converted to before the operation, set by Sema
+    CType *OperandType = nullptr;
 
     BinOpNode(TType OpType, PNode *LHS, PNode *RHS);
 
     ~BinOpNode();
 
+    CType *Check(Sema *S);
+
     llvm::Value *Emit(Gen *G);
 
+    IValue Eval(Interp *I);
+
     std::string ToString(int Depth = 0);
+
+    std::vector<PNode *> GetChildren();
+
+    PNode *Fold(Folder *F);
 };
 
 class UnOpNode : public PNode {
@@ -95,9 +156,17 @@ public:
 
     ~UnOpNode();
 
+    CType *Check(Sema *S);
+
     llvm::Value *Emit(Gen *G);
 
+    IValue Eval(Interp *I);
+
     std::string ToString(int Depth = 0);
+
+    std::vector<PNode *> GetChildren();
+
+    PNode *Fold(Folder *F);
 };
 
 class AllocNode : public PNode {
@@ -106,15 +175,33 @@ public:
     std::string Name;
     size_t PtrDepth;
     PNode *ArraySizeExpr;
+    // The pointer is the only way its pointee is accessed in the scope
+    bool IsRestrict = false;
+    // Bit n is set when the object n pointer levels above the named type is
+    // const, so bit PtrDepth qualifies the variable or array elements themselves
+    unsigned ConstLevels = 0;
 
     AllocNode(std::string AllocTypeName, std::string Name, size_t PtrDepth, PNode *ArraySizeExpr);
 
     ~AllocNode();
 
+    bool IsConst() const;
+
+    // Whether the declared pointer points to const
+    bool IsPointeeConst() const;
+
+    CType *Check(Sema *S);
+
     llvm::Value *Emit(Gen *G);
 
+    IValue Eval(Interp *I);
+
     std::string ToString(int Depth = 0);
 
+    std::vector<PNode *> GetChildren();
+
+    PNode *Fold(Folder *F);
+
     std::string ToTypeString();
 };
 
@@ -131,9 +218,37 @@ public:
 
     ~AssignNode();
 
+    CType *Check(Sema *S);
+
+    llvm::Value *Emit(Gen *G);
+
+    IValue Eval(Interp *I);
+
+    std::string ToString(int Depth = 0);
+
+    std::vector<PNode *> GetChildren();
+
+    PNode *Fold(Folder *F);
+};
+
+// Braced initializer of an array declaration, elements past the list are zero
+class InitListNode : public PNode {
+public:
+    std::vector<PNode *> Elements;
+
+    ~InitListNode();
+
+    CType *Check(Sema *S);
+
     llvm::Value *Emit(Gen *G);
 
+    IValue Eval(Interp *I);
+
     std::string ToString(int Depth = 0);
+
+    std::vector<PNode *> GetChildren();
+
+    PNode *Fold(Folder *F);
 };
 
 class BlockNode : public PNode {
@@ -144,9 +259,17 @@ public:
 
     ~BlockNode();
 
+    CType *Check(Sema *S);
+
     llvm::Value *Emit(Gen *G);
 
+    IValue Eval(Interp *I);
+
     std::string ToString(int Depth = 0);
+
+    std::vector<PNode *> GetChildren();
+
+    PNode *Fold(Folder *F);
 };
 
 class IfNode : public PNode {
@@ -154,14 +277,25 @@ public:
     PNode *CondExpr;
     PNode *BodyExpr;
     PNode *ElseBrExpr;
+    // 1 when the body is marked [[likely]] or the else branch [[unlikely]],
+    // -1 for the opposite and 0 without a hint
+    int Likelihood = 0;
 
     IfNode(PNode *CondExpr, PNode *BodyExpr, PNode *ElseBrExpr);
 
     ~IfNode();
 
+    CType *Check(Sema *S);
+
     llvm::Value *Emit(Gen *G);
 
+    IValue Eval(Interp *I);
+
     std::string ToString(int Depth = 0);
+
+    std::vector<PNode *> GetChildren();
+
+    PNode *Fold(Folder *F);
 };
 
 class RefNode : public PNode {
@@ -174,9 +308,30 @@ public:
 
     ~RefNode();
 
+    CType *Check(Sema *S);
+
     llvm::Value *Emit(Gen *G);
 
+    IValue Eval(Interp *I);
+
     std::string ToString(int Depth = 0);
+
+    std::vector<PNode *> GetChildren();
+
+    PNode *Fold(Folder *F);
+};
+
+// Transformations requested by #pragma lines before a for statement
+struct LoopHints {
+    // Unroll factor, 1 disables unrolling and 0 leaves it to the cost model
+    unsigned UnrollCount = 0;
+    bool UnrollFull = false;
+    // 1 forces vectorization, -1 disables it and 0 leaves it to the cost model
+    int Vectorize = 0;
+    unsigned VectorizeWidth = 0;
+    bool Distribute = false;
+
+    bool Empty() const;
 };
 
 class ForNode : public PNode {
@@ -185,28 +340,50 @@ public:
     PNode *CondExpr;
     PNode *UpdateExpr;
     PNode *BodyExpr;
+    LoopHints Hints;
 
     ForNode(PNode *InitExpr, PNode *CondExpr, PNode *UpdateExpr, PNode *BodyExpr);
 
     ~ForNode();
 
+    CType *Check(Sema *S);
+
     llvm::Value *Emit(Gen *G);
 
+    IValue Eval(Interp *I);
+
     std::string ToString(int Depth = 0);
+
+    std::vector<PNode *> GetChildren();
+
+    PNode *Fold(Folder *F);
 };
 
 class CallNode : public PNode {
 public:
     std::string CalleeName;
     std::vector<PNode *> ArgExprs;
+    // Declaration the call resolves to, set by Sema
+    PrototypeNode *Callee = nullptr;
 
     CallNode(std::string CalleeName);
 
     ~CallNode();
 
+    // __builtin_expect(expr, c) has the value of expr and hints that it equals c
+    bool IsBuiltinExpect() const;
+
+    CType *Check(Sema *S);
+
     llvm::Value *Emit(Gen *G);
 
+    IValue Eval(Interp *I);
+
     std::string ToString(int Depth = 0);
+
+    std::vector<PNode *> GetChildren();
+
+    PNode *Fold(Folder *F);
 };
 
 class PrototypeNode : public PNode {
@@ -216,14 +393,25 @@ public:
     std::vector<AllocNode *> Params;
     PNode *BodyExpr;
     bool IsVarArg;
+    // Internal linkage, and a definition the optimizer may drop once inlined
+    bool IsStatic = false;
+    bool IsInline = false;
 
     PrototypeNode(AllocNode *Type, std::string Name, std::vector<AllocNode *> Params, bool IsVarArg, PNode *BodyExpr);
 
     ~PrototypeNode();
 
+    CType *Check(Sema *S);
+
     llvm::Value *Emit(Gen *G);
 
+    IValue Eval(Interp *I);
+
     std::string ToString(int Depth = 0);
+
+    std::vector<PNode *> GetChildren();
+
+    PNode *Fold(Folder *F);
 };
 
 class ReturnNode : public PNode {
@@ -234,9 +422,17 @@ public:
 
     ~ReturnNode();
 
+    CType *Check(Sema *S);
+
     llvm::Value *Emit(Gen *G);
 
+    IValue Eval(Interp *I);
+
     std::string ToString(int Depth = 0);
+
+    std::vector<PNode *> GetChildren();
+
+    PNode *Fold(Folder *F);
 };
 
 class StructNode : public PNode {
@@ -248,9 +444,15 @@ public:
 
     ~StructNode();
 
+    CType *Check(Sema *S);
+
     llvm::Value *Emit(Gen *G);
 
+    IValue Eval(Interp *I);
+
     std::string ToString(int Depth);
+
+    std::vector<PNode *> GetChildren();
 };
 
 class TypedefNode : public PNode {
@@ -261,9 +463,15 @@ public:
 
     ~TypedefNode();
 
+    CType *Check(Sema *S);
+
     llvm::Value *Emit(Gen *G);
 
+    IValue Eval(Interp *I);
+
     std::string ToString(int Depth);
+
+    std::vector<PNode *> GetChildren();
 };
 
 #endif //CCOMP_NODES_H
@@ -35,10 +35,13 @@ Token Parser::Consume(TType Type, const char *ErrorMsg) {
     if (Check(Type)) {
         return Advance();
     }
-    std::cerr << "error " << Peek().Row + 1 << ":"
-              << Peek().Column + 1 << ": expected " << Token::GetName(Type)
-              << " got " << Token::GetName(Peek().Type) << ": " << ErrorMsg << std::endl;
-    exit(1);
+    ThrowError("expected " + Token::GetName(Type) + " got " + Token::GetName(Peek().Type) + ": " + ErrorMsg);
+}
+
+void Parser::ThrowError(const std::string &Text) {
+    throw CompileError(Peek().Row, Peek().Column,
+                       "error " + std::to_string(Peek().Row + 1) + ":" + std::to_string(Peek().Column + 1)
+                       + ": " + Text);
 }
 
 bool Parser::End() {
@@ -59,6 +62,12 @@ PNode *Parser::LocateNode(PNode *Node, Token Token) {
     return Node;
 }
 
+PNode *Parser::LocateRange(PNode *Node, size_t FirstToken) {
+    Node->FirstToken = FirstToken;
+    Node->LastToken = Current - 1;
+    return Node;
+}
+
 PNode *Parser::ParseBlock() {
     auto Block = new BlockNode();
     LocateNode(Block, Peek());
@@ -71,25 +80,38 @@ PNode *Parser::ParseBlock() {
 }
 
 PNode *Parser::ParseStatement() {
+    size_t FirstToken = Current;
+
     if (Check(TType::IF)) {
-        Advance();
-        return ParseIfStatement();
+        auto IfToken = Advance();
+        return LocateRange(LocateNode(ParseIfStatement(), IfToken), FirstToken);
     }
 
+    LoopHints Hints;
+    while (Check(TType::HASH))
+        ParsePragma(Hints);
+
     if (Check(TType::FOR)) {
-        Advance();
-        return ParseForStatement();
+        auto ForToken = Advance();
+        auto For = ParseForStatement();
+        For->Hints = Hints;
+        return LocateRange(LocateNode(For, ForToken), FirstToken);
     }
 
+    if (Current != FirstToken)
+        ThrowError("expected for statement after loop pragma");
+
     if (Check(TType::RETURN)) {
         Advance();
-        return ParseReturnStatement();
+        return LocateRange(ParseReturnStatement(), FirstToken);
     }
 
     auto Expr = ParseExpression();
+    if (!Expr)
+        ThrowError("expected statement");
     if (IsSemicolonRequired(Expr))
         Consume(TType::SEMICOLON, "expected semicolon after expression statement.");
-    return Expr;
+    return LocateRange(Expr, FirstToken);
 }
 
 bool Parser::IsSemicolonRequired(PNode *Expr) const {
@@ -101,6 +123,7 @@ PNode *Parser::ParseIfStatement() {
     Consume(TType::L_PAREN, "expected left parenthesis before condition.");
     PNode *CondExpr = ParseOr();
     Consume(TType::R_PAREN, "expected right parenthesis after condition.");
+    int Likelihood = ParseLikelihood();
     PNode *BodyExpr = ParseExpression();
 
     if (!dynamic_cast<BlockNode *>(BodyExpr))
@@ -109,13 +132,39 @@ PNode *Parser::ParseIfStatement() {
     PNode *ElseBrExpr = nullptr;
     if (Check(TType::ELSE)) {
         Advance();
+        // A hint on the else branch is one on the body with the opposite direction
+        int ElseLikelihood = ParseLikelihood();
+        if (!Likelihood)
+            Likelihood = -ElseLikelihood;
         ElseBrExpr = ParseExpression();
     }
 
-    return new IfNode(CondExpr, BodyExpr, ElseBrExpr);
+    auto If = new IfNode(CondExpr, BodyExpr, ElseBrExpr);
+    If->Likelihood = Likelihood;
+    return If;
+}
+
+int Parser::ParseLikelihood() {
+    if (!Check(TType::L_SCR) || Peek(1).Type != TType::L_SCR)
+        return 0;
+    Advance();
+    Advance();
+
+    std::string Name = Consume(TType::IDENTIFIER, "expected attribute name.").Var.As.CharPtr;
+    int Likelihood;
+    if (Name == "likely")
+        Likelihood = 1;
+    else if (Name == "unlikely")
+        Likelihood = -1;
+    else
+        ThrowError("unknown attribute `" + Name + "`");
+
+    Consume(TType::R_SCR, "expected ']]' after attribute.");
+    Consume(TType::R_SCR, "expected ']]' after attribute.");
+    return Likelihood;
 }
 
-PNode *Parser::ParseForStatement() {
+ForNode *Parser::ParseForStatement() {
     Consume(TType::L_PAREN, "expected left parenthesis before condition.");
     PNode *InitExpr = ParseExpression();
     Consume(TType::SEMICOLON, "expected semicolon after initializer.");
@@ -131,6 +180,48 @@ PNode *Parser::ParseForStatement() {
     return new ForNode(InitExpr, CondExpr, UpdateExpr, BodyExpr);
 }
 
+void Parser::ParsePragma(LoopHints &Hints) {
+    Advance();
+    std::string Directive = Consume(TType::IDENTIFIER, "expected directive after '#'.").Var.As.CharPtr;
+    if (Directive != "pragma")
+        ThrowError("unknown directive `#" + Directive + "`");
+
+    std::string Name = Consume(TType::IDENTIFIER, "expected pragma name.").Var.As.CharPtr;
+    if (Name == "unroll") {
+        if (Check(TType::L_PAREN))
+            Hints.UnrollCount = ParsePragmaCount();
+        else
+            Hints.UnrollFull = true;
+    } else if (Name == "vectorize") {
+        if (Check(TType::L_PAREN)) {
+            Advance();
+            std::string Mode = Consume(TType::IDENTIFIER, "expected enable or disable.").Var.As.CharPtr;
+            if (Mode != "enable" && Mode != "disable")
+                ThrowError("expected enable or disable");
+            Hints.Vectorize = Mode == "enable" ? 1 : -1;
+            Consume(TType::R_PAREN, "expected right parenthesis after pragma argument.");
+        } else {
+            std::string Option = Consume(TType::IDENTIFIER, "expected width.").Var.As.CharPtr;
+            if (Option != "width")
+                ThrowError("unknown vectorize option `" + Option + "`");
+            Hints.VectorizeWidth = ParsePragmaCount();
+            Hints.Vectorize = 1;
+        }
+    } else if (Name == "distribute") {
+        Hints.Distribute = true;
+    } else
+        ThrowError("unknown pragma `" + Name + "`");
+}
+
+unsigned Parser::ParsePragmaCount() {
+    Consume(TType::L_PAREN, "expected left parenthesis before pragma argument.");
+    if (!Check(TType::INTEGER) || Peek().Var.As.Int < 1)
+        ThrowError("expected a positive integer");
+    auto Count = Advance().Var.As.Int;
+    Consume(TType::R_PAREN, "expected right parenthesis after pragma argument.");
+    return Count;
+}
+
 PNode *Parser::ParseReturnStatement() {
     ReturnNode *Node = new ReturnNode(nullptr);
     LocateNode(Node, Previous());
@@ -155,7 +246,8 @@ PNode *Parser::ParseAssignment() {
         Token Token = Peek();
         Advance();
 
-        PNode *Expr = ParseOr();
+        // Only a declaration can be initialized with a braced list
+        PNode *Expr = dynamic_cast<AllocNode *>(Node) && Check(TType::L_BRACE) ? ParseInitList() : ParseOr();
         auto Ident = dynamic_cast<IdentifierNode *>(Node);
 
         if (Ident) {
@@ -171,6 +263,25 @@ PNode *Parser::ParseAssignment() {
     return Node;
 }
 
+PNode *Parser::ParseInitList() {
+    auto List = new InitListNode();
+    LocateNode(List, Peek());
+    Consume(TType::L_BRACE, "expected left brace");
+
+    while (!Check(TType::R_BRACE)) {
+        auto Element = ParseOr();
+        if (!Element)
+            ThrowError("expected initializer element");
+        List->Elements.push_back(Element);
+        if (!Check(TType::COMMA))
+            break;
+        Advance();
+    }
+
+    Consume(TType::R_BRACE, "expected right brace after initializer list");
+    return List;
+}
+
 PNode *Parser::ParseOr() {
     PNode *Node = ParseAnd();
 
@@ -299,6 +410,8 @@ PNode *Parser::ParseCall() {
         if (Check(TType::L_PAREN)) {
             Advance();
             auto IdentNode = dynamic_cast<IdentifierNode *>(Node);
+            if (!IdentNode)
+                ThrowError("called object is not a function name");
             auto Call = new CallNode(IdentNode->Name);
             LocateNode(Call, Previous());
 
@@ -330,7 +443,7 @@ PNode *Parser::ParsePrimary() {
         PNode *IndexExpr = nullptr;
 
         if (Check(TType::IDENTIFIER)
-            || IsTypeDeclared(Text) && Check(TType::STAR)) {
+            || IsTypeDeclared(Text) && (Check(TType::STAR) || Check(TType::CONST))) {
             return ParseAlloc(Text);
         }
 
@@ -355,6 +468,12 @@ PNode *Parser::ParsePrimary() {
         return ParseTypedef();
     }
 
+    if (Check(TType::STATIC) || Check(TType::INLINE))
+        return ParseSpecifiedFunction();
+
+    if (Check(TType::CONST))
+        return ParseConstDeclaration();
+
     if (Check(TType::INTEGER)) {
         Advance();
         return LocateNode(new IntegerNode(Previous().Var.As.Int, 32), Previous());
@@ -390,6 +509,8 @@ bool Parser::IsTypeDeclared(const char *Text) { return std::find(Types.begin(),
 PNode *Parser::ParseTypedef() {
     auto TypedefToken = Peek(-1);
 
+    // Qualifiers are not part of a type name
+    ParseConst();
     if (Check(TType::STRUCT))
         Advance();
 
@@ -401,6 +522,40 @@ PNode *Parser::ParseTypedef() {
     return LocateNode(new TypedefNode(Alloc), TypedefToken);
 }
 
+PNode *Parser::ParseSpecifiedFunction() {
+    bool IsStatic = false, IsInline = false;
+    while (Check(TType::STATIC) || Check(TType::INLINE))
+        (Advance().Type == TType::STATIC ? IsStatic : IsInline) = true;
+
+    auto Proto = Check(TType::IDENTIFIER) ? dynamic_cast<PrototypeNode *>(ParsePrimary()) : nullptr;
+    if (!Proto)
+        ThrowError("expected function after `static` or `inline`");
+    Proto->IsStatic = IsStatic;
+    Proto->IsInline = IsInline;
+    return Proto;
+}
+
+PNode *Parser::ParseConstDeclaration() {
+    ParseConst();
+    auto Node = Check(TType::IDENTIFIER) || Check(TType::STRUCT) ? ParsePrimary() : nullptr;
+    if (auto Alloc = dynamic_cast<AllocNode *>(Node))
+        Alloc->ConstLevels |= 1;
+    else if (auto Proto = dynamic_cast<PrototypeNode *>(Node))
+        Proto->ReturnAllocNode->ConstLevels |= 1;
+    else
+        ThrowError("expected declaration after `const`");
+    return Node;
+}
+
+bool Parser::ParseConst() {
+    bool IsConst = false;
+    while (Check(TType::CONST)) {
+        Advance();
+        IsConst = true;
+    }
+    return IsConst;
+}
+
 void Parser::DefineType(const AllocNode *Alloc) { Types.push_back(Alloc->Name); }
 
 PNode *Parser::ParseStruct() {
@@ -415,11 +570,13 @@ PNode *Parser::ParseStruct() {
         std::vector<AllocNode *> Allocs;
 
         while (true) {
+            bool IsConst = ParseConst();
             auto VarTypeName = Peek().Var.As.CharPtr;
             Consume(TType::IDENTIFIER, "expected field type");
 
             auto Node = ParseAlloc(VarTypeName);
             auto Alloc = dynamic_cast<AllocNode *>(Node);
+            Alloc->ConstLevels |= IsConst;
 
             Allocs.push_back(Alloc);
 
@@ -441,8 +598,19 @@ PNode *Parser::ParseAlloc(std::string type) {
     std::string Name;
 
     int PtrDepth = 0;
+    bool IsRestrict = false;
+    unsigned ConstLevels = 0;
     PNode *ArraySizeExpr = nullptr;
 
+    // Sema rejects restrict on anything but a pointer
+    while (Check(TType::RESTRICT) || Check(TType::CONST)) {
+        if (Advance().Type == TType::CONST)
+            ConstLevels |= 1;
+        else
+            IsRestrict = true;
+    }
+    NameToken = Peek();
+
     if (Check(TType::IDENTIFIER)) {
         Advance();
         Name = NameToken.Var.As.CharPtr;
@@ -452,6 +620,14 @@ PNode *Parser::ParseAlloc(std::string type) {
         while (Check(TType::STAR)) {
             Advance();
             PtrDepth++;
+            // Only the qualifier of the outermost pointer is kept
+            IsRestrict = false;
+            while (Check(TType::RESTRICT) || Check(TType::CONST)) {
+                if (Advance().Type == TType::CONST)
+                    ConstLevels |= 1u << PtrDepth;
+                else
+                    IsRestrict = true;
+            }
         }
         NameToken = Peek();
         Name = NameToken.Var.As.CharPtr;
@@ -466,6 +642,8 @@ PNode *Parser::ParseAlloc(std::string type) {
     }
 
     auto Node = new AllocNode(type, Name, PtrDepth, ArraySizeExpr);
+    Node->IsRestrict = IsRestrict;
+    Node->ConstLevels = ConstLevels;
     LocateNode(Node, NameToken);
 
     if (Check(TType::L_PAREN)) {
@@ -481,11 +659,13 @@ PNode *Parser:: ParsePrototype(AllocNode *ReturnAlloc, std::string Name, Token P
     bool IsVarArg = false;
     bool Comma = false;
     do {
+        bool IsConst = ParseConst();
         if (Check(TType::IDENTIFIER)) {
             auto ArgTypeName = Peek().Var.As.CharPtr;
             Advance();
             auto Node = ParseAlloc(ArgTypeName);
             auto Alloc = dynamic_cast<AllocNode *>(Node);
+            Alloc->ConstLevels |= IsConst;
             Params.push_back(Alloc);
             Comma = Check(TType::COMMA);
             if (Comma)
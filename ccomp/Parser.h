@@ -8,6 +8,7 @@
 #include "llvm/IR/Constants.h"
 #include "Token.h"
 #include "Nodes.h"
+#include "CompileError.h"
 
 class Parser {
 private:
@@ -26,6 +27,9 @@ private:
 
     Token Consume(TType Type, const char *ErrorMsg);
 
+    // Reports a syntax error at the current token
+    [[noreturn]] void ThrowError(const std::string &Text);
+
     bool End();
 
     Token Peek(int Offset = 0);
@@ -34,13 +38,26 @@ private:
 
     PNode *LocateNode(PNode *Node, Token Token);
 
+    // Records the tokens from FirstToken up to the last consumed one as the range of Node
+    PNode *LocateRange(PNode *Node, size_t FirstToken);
+
     PNode *ParseBlock();
 
     PNode *ParseStatement();
 
     PNode *ParseIfStatement();
 
-    PNode *ParseForStatement();
+    // [[likely]] or [[unlikely]] before a branch of an if statement, 0 when absent
+    int ParseLikelihood();
+
+    ForNode *ParseForStatement();
+
+    // #pragma unroll, unroll(N), vectorize width(N), vectorize(enable|disable)
+    // or distribute before a for statement
+    void ParsePragma(LoopHints &Hints);
+
+    // Parenthesized positive count of a pragma
+    unsigned ParsePragmaCount();
 
     PNode *ParseReturnStatement();
 
@@ -48,6 +65,8 @@ private:
 
     PNode *ParseAssignment();
 
+    PNode *ParseInitList();
+
     PNode *ParseOr();
 
     PNode *ParseAnd();
@@ -70,6 +89,15 @@ private:
 
     PNode *ParseTypedef();
 
+    // Parses a function after its `static` and `inline` specifiers
+    PNode *ParseSpecifiedFunction();
+
+    // Parses a declaration after a leading `const`
+    PNode *ParseConstDeclaration();
+
+    // Skips const qualifiers, true if there were any
+    bool ParseConst();
+
     PNode *ParseAlloc(std::string type);
 
     PNode *ParsePrototype(AllocNode *ReturnAlloc, std::string Name, Token ProtToken);
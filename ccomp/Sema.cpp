@@ -0,0 +1,653 @@
+#include "Sema.h"
+
+bool CType::IsVoid() const {
+    return TypeKind == VOID;
+}
+
+bool CType::IsInteger() const {
+    return TypeKind == INT;
+}
+
+bool CType::IsFloat() const {
+    return TypeKind == FLOAT;
+}
+
+bool CType::IsArithmetic() const {
+    return TypeKind == INT || TypeKind == FLOAT;
+}
+
+bool CType::IsPointer() const {
+    return TypeKind == POINTER;
+}
+
+bool CType::IsArray() const {
+    return TypeKind == ARRAY;
+}
+
+bool CType::IsStruct() const {
+    return TypeKind == STRUCT;
+}
+
+bool CType::IsScalar() const {
+    return IsArithmetic() || IsPointer();
+}
+
+std::string CType::ToString() const {
+    switch (TypeKind) {
+        case VOID:
+            return "void";
+        case INT:
+            switch (Size) {
+                case 1:
+                    return "char";
+                case 2:
+                    return "short";
+                case 4:
+                    return "int";
+                default:
+                    return "long";
+            }
+        case FLOAT:
+            return Size == 4 ? "float" : "double";
+        case POINTER:
+            return Base->ToString() + " *";
+        case ARRAY:
+            return Base->ToString() + " [" + (IsVLA ? "*" : std::to_string(Count)) + "]";
+        default:
+            return "struct " + Name;
+    }
+}
+
+TypeContext::TypeContext() {
+    Void = Create(CType::VOID);
+    Char = Create(CType::INT, 1);
+    Short = Create(CType::INT, 2);
+    Int = Create(CType::INT, 4);
+    Long = Create(CType::INT, 8);
+    Float = Create(CType::FLOAT, 4);
+    Double = Create(CType::FLOAT, 8);
+}
+
+CType *TypeContext::Create(CType::Kind Kind, size_t Size, CType *Base) {
+    auto Type = new CType();
+    Type->TypeKind = Kind;
+    Type->Size = Size;
+    Type->IsSigned = Kind == CType::INT;
+    Type->Base = Base;
+    Type->Count = 0;
+    Type->IsVLA = false;
+    Type->PointerTo = nullptr;
+    Type->VLAOf = nullptr;
+    Types.emplace_back(Type);
+    return Type;
+}
+
+CType *TypeContext::GetPointer(CType *Pointee) {
+    if (!Pointee->PointerTo)
+        Pointee->PointerTo = Create(CType::POINTER, sizeof(void *), Pointee);
+    return Pointee->PointerTo;
+}
+
+CType *TypeContext::GetArray(CType *Element, uint64_t Count) {
+    auto &Type = Arrays[{Element, Count}];
+    if (!Type) {
+        Type = Create(CType::ARRAY, 0, Element);
+        Type->Count = Count;
+    }
+    return Type;
+}
+
+CType *TypeContext::GetVLA(CType *Element) {
+    if (!Element->VLAOf) {
+        Element->VLAOf = Create(CType::ARRAY, 0, Element);
+        Element->VLAOf->IsVLA = true;
+    }
+    return Element->VLAOf;
+}
+
+CType *TypeContext::CreateStruct(const std::string &Name) {
+    auto Type = Create(CType::STRUCT);
+    Type->Name = Name;
+    return Type;
+}
+
+Sema::Sema() : ReturnType(nullptr), ReturnDecl(nullptr) {
+    TypeNames.emplace("void", Types.Void);
+    TypeNames.emplace("char", Types.Char);
+    TypeNames.emplace("short", Types.Short);
+    TypeNames.emplace("int", Types.Int);
+    TypeNames.emplace("long", Types.Long);
+    TypeNames.emplace("float", Types.Float);
+    TypeNames.emplace("double", Types.Double);
+}
+
+CType *Sema::ThrowError(PNode *RelatedNode, std::string Text) {
+    throw CompileError(RelatedNode->Row, RelatedNode->Column,
+                       "error at " + std::to_string(RelatedNode->Row + 1) + ":"
+                       + std::to_string(RelatedNode->Column + 1) + ": " + Text);
+}
+
+void Sema::Check(PNode *Node) {
+    // Global scope, mirrors the one the generator pushes
+    PushScope();
+    Node->Check(this);
+    PopScope();
+}
+
+void Sema::PushScope() {
+    Variables.PushScope();
+    Declarations.PushScope();
+}
+
+void Sema::PopScope() {
+    Variables.PopScope();
+    Declarations.PopScope();
+}
+
+bool Sema::TryPutVar(AllocNode *Alloc, CType *Type) {
+    return Variables.TryPut(Alloc->Name, Type) && Declarations.TryPut(Alloc->Name, Alloc);
+}
+
+bool Sema::TryGetVar(llvm::StringRef Name, CType **TypePtr) {
+    return Variables.TryGet(Name, TypePtr);
+}
+
+AllocNode *Sema::GetDeclaration(llvm::StringRef Name) {
+    AllocNode *Alloc = nullptr;
+    Declarations.TryGet(Name, &Alloc);
+    return Alloc;
+}
+
+// Whether the object Level pointer levels above the named type of Decl is const
+static bool IsConstAt(AllocNode *Decl, int Level) {
+    return Level >= 0 && (Decl->ConstLevels >> Level & 1);
+}
+
+bool Sema::TryPutType(const std::string &Name, CType *Type) {
+    return TypeNames.try_emplace(Name, Type).second;
+}
+
+bool Sema::TryGetType(const std::string &Name, CType **TypePtr) {
+    auto Result = TypeNames.find(Name);
+    if (Result == TypeNames.end())
+        return false;
+    *TypePtr = Result->second;
+    return true;
+}
+
+CType *Sema::GetAllocType(AllocNode *Alloc) {
+    CType *Type;
+    if (!TryGetType(Alloc->AllocTypeName, &Type))
+        return ThrowError(Alloc, "unknown type `" + Alloc->AllocTypeName + "`");
+    for (size_t i = 0; i < Alloc->PtrDepth; i++)
+        Type = Types.GetPointer(Type);
+    if (Alloc->IsRestrict && !Type->IsPointer())
+        return ThrowError(Alloc, "restrict requires a pointer type");
+    return Type;
+}
+
+CType *Sema::Decay(CType *Type) {
+    return Type->IsArray() ? Types.GetPointer(Type->Base) : Type;
+}
+
+CType *Sema::Promote(CType *Type) {
+    return Type->IsInteger() && Type->Size < 4 ? Types.Int : Type;
+}
+
+CType *Sema::GetCommonType(CType *L, CType *R) {
+    if (L->IsFloat() || R->IsFloat()) {
+        auto Size = std::max(L->IsFloat() ? L->Size : 0, R->IsFloat() ? R->Size : 0);
+        return Size == 4 ? Types.Float : Types.Double;
+    }
+    L = Promote(L);
+    R = Promote(R);
+    return L->Size >= R->Size ? L : R;
+}
+
+CType *Sema::CheckOperand(PNode *Parent, PNode *Operand) {
+    if (!Operand)
+        return ThrowError(Parent, "expected expression");
+    return Operand->Check(this);
+}
+
+void Sema::CheckAssignable(PNode *RelatedNode, CType *From, CType *To) {
+    // Integers and pointers convert to each other as in the interpreter
+    if (From == To || (To->IsArithmetic() && From->IsArithmetic()) || (To->IsPointer() && From->IsPointer())
+        || (To->IsPointer() && From->IsInteger()) || (To->IsInteger() && From->IsPointer()))
+        return;
+    ThrowError(RelatedNode, "cannot convert `" + From->ToString() + "` to `" + To->ToString() + "`");
+}
+
+bool Sema::PointsToConst(PNode *Expr) {
+    if (auto BinOp = dynamic_cast<BinOpNode *>(Expr))
+        return BinOp->Type->IsPointer() && (PointsToConst(BinOp->LHS) || PointsToConst(BinOp->RHS));
+    if (auto Call = dynamic_cast<CallNode *>(Expr))
+        return Call->Callee && Call->Callee->ReturnAllocNode->IsPointeeConst();
+
+    auto Ref = dynamic_cast<RefNode *>(Expr);
+    auto Ident = dynamic_cast<IdentifierNode *>(Ref ? Ref->Expr : Expr);
+    auto Decl = Ident ? GetDeclaration(Ident->Name) : nullptr;
+    if (!Decl)
+        return false;
+
+    // An array decays to a pointer to its elements, which sit at the declared level
+    bool IsArray = Decl->Type->IsArray();
+    int Level = (int) Decl->PtrDepth - !IsArray - (Ident->IndexExpr != nullptr);
+    if (Ref && Ref->IsDeref)
+        Level -= Ref->Depth;
+    else if (Ref && (Ident->IndexExpr || !IsArray))
+        Level++;
+    return IsConstAt(Decl, Level);
+}
+
+// Evaluates an integer constant expression such as an array size
+static bool TryEvaluateConstant(PNode *Node, int64_t *Result) {
+    if (auto Int = dynamic_cast<IntegerNode *>(Node)) {
+        *Result = (int64_t) Int->Value;
+        return true;
+    }
+
+    if (auto UnOp = dynamic_cast<UnOpNode *>(Node)) {
+        int64_t Val;
+        if (UnOp->OpType != TType::MINUS || !TryEvaluateConstant(UnOp->Expr, &Val))
+            return false;
+        *Result = (int64_t) (0 - (uint64_t) Val);
+        return true;
+    }
+
+    auto BinOp = dynamic_cast<BinOpNode *>(Node);
+    int64_t L, R;
+    if (!BinOp || !TryEvaluateConstant(BinOp->LHS, &L) || !TryEvaluateConstant(BinOp->RHS, &R))
+        return false;
+
+    switch (BinOp->OpType) {
+        case TType::PLUS:
+            *Result = (int64_t) ((uint64_t) L + (uint64_t) R);
+            return true;
+        case TType::MINUS:
+            *Result = (int64_t) ((uint64_t) L - (uint64_t) R);
+            return true;
+        case TType::STAR:
+            *Result = (int64_t) ((uint64_t) L * (uint64_t) R);
+            return true;
+        case TType::SLASH:
+        case TType::PERCENT:
+            if (R == 0)
+                return false;
+            *Result = BinOp->OpType == TType::SLASH ? L / R : L % R;
+            return true;
+        default:
+            return false;
+    }
+}
+
+CType *IdentifierNode::Check(Sema *S) {
+    CType *VarType;
+    if (!S->TryGetVar(Name, &VarType))
+        return S->ThrowError(this, "unknown variable name `" + Name + "`");
+
+    if (!IndexExpr)
+        return Type = S->Decay(VarType);
+
+    if (!S->CheckOperand(this, IndexExpr)->IsInteger())
+        return S->ThrowError(IndexExpr, "array subscript is not an integer");
+    if (!VarType->IsArray() && !VarType->IsPointer())
+        return S->ThrowError(this, "indexee must be array or a pointer");
+    if (VarType->Base->IsVoid())
+        return S->ThrowError(this, "subscript of pointer to void");
+    return Type = S->Decay(VarType->Base);
+}
+
+CType *IntegerNode::Check(Sema *S) {
+    switch (NumBits) {
+        case 8:
+            return Type = S->Types.Char;
+        case 16:
+            return Type = S->Types.Short;
+        case 32:
+            return Type = S->Types.Int;
+        default:
+            return Type = S->Types.Long;
+    }
+}
+
+CType *FloatNode::Check(Sema *S) {
+    return Type = S->Types.Double;
+}
+
+CType *StringNode::Check(Sema *S) {
+    return Type = S->Types.GetPointer(S->Types.Char);
+}
+
+CType *BinOpNode::Check(Sema *S) {
+    auto L = S->CheckOperand(this, LHS);
+    auto R = S->CheckOperand(this, RHS);
+
+    bool IsComparison = OpType == TType::D_EQUAL || OpType == TType::BANG_EQ || OpType == TType::LESS
+                        || OpType == TType::LESS_EQ || OpType == TType::GREAT || OpType == TType::GREAT_EQ;
+
+    if (OpType == TType::AND || OpType == TType::OR) {
+        if (!L->IsScalar() || !R->IsScalar())
+            return S->ThrowError(this, "invalid operands to binary " + Token::GetName(OpType));
+        // Each operand is tested against zero in its own type, the result is an int truth value
+        OperandType = S->Types.Int;
+        return Type = S->Types.Int;
+    }
+
+    if (L->IsPointer() || R->IsPointer()) {
+        auto Ptr = L->IsPointer() ? L : R;
+        auto Other = L->IsPointer() ? R : L;
+        OperandType = Ptr;
+
+        if (IsComparison && (Other->IsPointer() || Other->IsInteger()))
+            return Type = S->Types.Int;
+
+        if (OpType == TType::PLUS || OpType == TType::MINUS) {
+            if (Ptr->Base->IsVoid() || Ptr->Base->IsArray())
+                return S->ThrowError(this, "arithmetic on a pointer to `" + Ptr->Base->ToString() + "`");
+            if (Other->IsInteger() && (OpType == TType::PLUS || L->IsPointer()))
+                return Type = Ptr;
+            if (OpType == TType::MINUS && L == R)
+                return Type = S->Types.Long;
+        }
+        return S->ThrowError(this, "invalid operands to binary " + Token::GetName(OpType));
+    }
+
+    if (!L->IsArithmetic() || !R->IsArithmetic())
+        return S->ThrowError(this, "invalid operands to binary " + Token::GetName(OpType));
+
+    OperandType = S->GetCommonType(L, R);
+    if (IsComparison)
+        return Type = S->Types.Int;
+
+    switch (OpType) {
+        case TType::PLUS:
+        case TType::MINUS:
+        case TType::STAR:
+        case TType::SLASH:
+            return Type = OperandType;
+        case TType::PERCENT:
+        case TType::BIN_OR:
+        case TType::BIN_AND:
+            if (!OperandType->IsInteger())
+                return S->ThrowError(this, "invalid operands to binary " + Token::GetName(OpType));
+            return Type = OperandType;
+        default:
+            return S->ThrowError(this, "unknown binary operator");
+    }
+}
+
+CType *UnOpNode::Check(Sema *S) {
+    auto ExprType = S->CheckOperand(this, Expr);
+    switch (OpType) {
+        case TType::BANG:
+            if (!ExprType->IsScalar())
+                return S->ThrowError(this, "invalid operand to unary !");
+            return Type = S->Types.Int;
+        case TType::MINUS:
+            if (!ExprType->IsArithmetic())
+                return S->ThrowError(this, "invalid operand to unary -");
+            return Type = S->Promote(ExprType);
+        default:
+            return S->ThrowError(this, "unknown unary operator");
+    }
+}
+
+CType *AssignNode::Check(Sema *S) {
+    CType *TargetType;
+    AllocNode *Decl = Alloc;
+    // Level of the stored object in the qualifiers of its declaration
+    int Level;
+    if (Alloc) {
+        TargetType = Alloc->Check(S);
+        Level = (int) Alloc->PtrDepth;
+    } else {
+        if (!S->TryGetVar(Ident->Name, &TargetType))
+            return S->ThrowError(Ident, "unknown variable name `" + Ident->Name + "`");
+        Ident->Check(S);
+        Decl = S->GetDeclaration(Ident->Name);
+        Level = (int) Decl->PtrDepth - (Ident->IndexExpr && TargetType->IsPointer());
+        if (Ident->IndexExpr)
+            TargetType = TargetType->Base;
+
+        if (IsConstAt(Decl, Level)) {
+            if (Level == (int) Decl->PtrDepth)
+                return S->ThrowError(this, "cannot assign to const variable `" + Ident->Name + "`");
+            return S->ThrowError(this, "cannot assign through pointer to const `" + Ident->Name + "`");
+        }
+    }
+
+    if (auto List = dynamic_cast<InitListNode *>(Expr)) {
+        if (!TargetType->IsArray() || TargetType->IsVLA)
+            return S->ThrowError(this, "initializer list for `" + Alloc->Name + "` requires a fixed-size array");
+        if (List->Elements.size() > TargetType->Count)
+            return S->ThrowError(List, "excess elements in initializer of `" + Alloc->Name + "`");
+        for (auto Element: List->Elements)
+            S->CheckAssignable(Element, Element->Check(S), TargetType->Base);
+        List->Type = TargetType;
+        return Type = TargetType;
+    }
+
+    if (TargetType->IsArray())
+        return S->ThrowError(this, "array type `" + TargetType->ToString() + "` is not assignable");
+
+    S->CheckAssignable(this, S->CheckOperand(this, Expr), TargetType);
+    if (TargetType->IsPointer() && !IsConstAt(Decl, Level - 1) && S->PointsToConst(Expr))
+        return S->ThrowError(this, "assigning to `" + Decl->Name + "` discards const qualifier");
+    return Type = TargetType;
+}
+
+CType *InitListNode::Check(Sema *S) {
+    return S->ThrowError(this, "initializer list outside of a declaration");
+}
+
+CType *RefNode::Check(Sema *S) {
+    auto ExprType = S->CheckOperand(this, Expr);
+
+    if (IsDeref) {
+        for (int i = 0; i < Depth; i++) {
+            if (!ExprType->IsPointer())
+                return S->ThrowError(Expr, "cannot dereference not pointer");
+            ExprType = ExprType->Base;
+            if (ExprType->IsVoid())
+                return S->ThrowError(this, "dereference of pointer to void");
+            ExprType = S->Decay(ExprType);
+        }
+        return Type = ExprType;
+    }
+
+    auto Ident = dynamic_cast<IdentifierNode *>(Expr);
+    if (!Ident)
+        return S->ThrowError(this, "cannot reference not identifier");
+
+    CType *VarType;
+    S->TryGetVar(Ident->Name, &VarType);
+    if (Ident->IndexExpr)
+        VarType = VarType->Base;
+    return Type = S->Types.GetPointer(VarType);
+}
+
+CType *AllocNode::Check(Sema *S) {
+    auto VarType = S->GetAllocType(this);
+    if (VarType->IsVoid())
+        return S->ThrowError(this, "variable `" + Name + "` has incomplete type `void`");
+
+    if (ArraySizeExpr) {
+        if (!ArraySizeExpr->Check(S)->IsInteger())
+            return S->ThrowError(ArraySizeExpr, "size of array `" + Name + "` has non-integer type");
+
+        int64_t Count;
+        if (TryEvaluateConstant(ArraySizeExpr, &Count)) {
+            if (Count < 0)
+                return S->ThrowError(this, "size of array `" + Name + "` is negative");
+            VarType = S->Types.GetArray(VarType, Count);
+        } else if (!S->ReturnType) {
+            return S->ThrowError(this, "variable length array declared at file scope");
+        } else
+            VarType = S->Types.GetVLA(VarType);
+    }
+
+    if (!S->TryPutVar(this, VarType))
+        return S->ThrowError(this, "redefinition of `" + Name + "`");
+    return Type = VarType;
+}
+
+CType *StructNode::Check(Sema *S) {
+    auto StrType = S->Types.CreateStruct(Name);
+    if (!S->TryPutType(Name, StrType))
+        return S->ThrowError(AllocNodes.front(), "struct name `" + Name + "` already exists");
+
+    for (auto Alloc : AllocNodes) {
+        auto FieldType = S->GetAllocType(Alloc);
+        if (FieldType->IsVoid() || FieldType == StrType)
+            return S->ThrowError(Alloc, "field `" + Alloc->Name + "` has incomplete type");
+
+        if (Alloc->ArraySizeExpr) {
+            int64_t Count;
+            if (!TryEvaluateConstant(Alloc->ArraySizeExpr, &Count) || Count < 0)
+                return S->ThrowError(Alloc, "size of field `" + Alloc->Name + "` is not a constant");
+            FieldType = S->Types.GetArray(FieldType, Count);
+        }
+
+        Alloc->Type = FieldType;
+        StrType->FieldNames.push_back(Alloc->Name);
+        StrType->FieldTypes.push_back(FieldType);
+    }
+    return Type = StrType;
+}
+
+CType *TypedefNode::Check(Sema *S) {
+    auto DefType = S->GetAllocType(Alloc);
+    if (!S->TryPutType(Alloc->Name, DefType))
+        return S->ThrowError(this, "type `" + Alloc->Name + "` exists");
+    return Type = Alloc->Type = DefType;
+}
+
+CType *BlockNode::Check(Sema *S) {
+    S->PushScope();
+    for (auto Node: Nodes)
+        Node->Check(S);
+    S->PopScope();
+    return Type = S->Types.Void;
+}
+
+CType *IfNode::Check(Sema *S) {
+    if (!S->CheckOperand(this, CondExpr)->IsScalar())
+        return S->ThrowError(CondExpr, "condition has non-scalar type");
+
+    S->CheckOperand(this, BodyExpr);
+    if (ElseBrExpr)
+        ElseBrExpr->Check(S);
+    return Type = S->Types.Void;
+}
+
+CType *ForNode::Check(Sema *S) {
+    S->PushScope();
+
+    if (InitExpr)
+        InitExpr->Check(S);
+    if (CondExpr && !CondExpr->Check(S)->IsScalar())
+        return S->ThrowError(CondExpr, "condition has non-scalar type");
+    if (UpdateExpr)
+        UpdateExpr->Check(S);
+    S->CheckOperand(this, BodyExpr);
+
+    S->PopScope();
+    return Type = S->Types.Void;
+}
+
+CType *CallNode::Check(Sema *S) {
+    if (IsBuiltinExpect()) {
+        if (ArgExprs.size() != 2)
+            return S->ThrowError(this, "incorrect # arguments passed to `" + CalleeName + "`");
+        for (auto ArgExpr: ArgExprs)
+            if (!S->CheckOperand(this, ArgExpr)->IsInteger())
+                return S->ThrowError(ArgExpr, "argument of `" + CalleeName + "` has non-integer type");
+        return Type = S->Types.Long;
+    }
+
+    auto Result = S->Functions.find(CalleeName);
+    if (Result == S->Functions.end())
+        return S->ThrowError(this, "unknown function `" + CalleeName + "` referenced");
+
+    Callee = Result->second;
+    if (ArgExprs.size() < Callee->Params.size() || (!Callee->IsVarArg && ArgExprs.size() != Callee->Params.size()))
+        return S->ThrowError(this, "incorrect # arguments passed to `" + CalleeName + "`");
+
+    for (size_t i = 0; i < ArgExprs.size(); i++) {
+        auto ArgType = S->CheckOperand(this, ArgExprs[i]);
+        if (i < Callee->Params.size()) {
+            auto Param = Callee->Params[i];
+            S->CheckAssignable(ArgExprs[i], ArgType, Param->Type);
+            if (Param->Type->IsPointer() && !Param->IsPointeeConst() && S->PointsToConst(ArgExprs[i]))
+                return S->ThrowError(ArgExprs[i], "passing argument to `" + Param->Name + "` discards const qualifier");
+        } else if (!ArgType->IsScalar())
+            return S->ThrowError(ArgExprs[i], "variadic argument has non-scalar type");
+    }
+    return Type = Callee->Type;
+}
+
+CType *PrototypeNode::Check(Sema *S) {
+    Type = ReturnAllocNode->Type = S->GetAllocType(ReturnAllocNode);
+    for (auto Param: Params) {
+        Param->Type = S->GetAllocType(Param);
+        if (Param->Type->IsVoid() || Param->ArraySizeExpr)
+            return S->ThrowError(Param, "invalid type of parameter `" + Param->Name + "`");
+    }
+
+    auto Result = S->Functions.find(Name);
+    if (Result != S->Functions.end()) {
+        auto Previous = Result->second;
+        bool Same = Previous->Type == Type && Previous->IsVarArg == IsVarArg
+                    && Previous->Params.size() == Params.size();
+        for (size_t i = 0; Same && i < Params.size(); i++)
+            Same = Previous->Params[i]->Type == Params[i]->Type;
+        if (!Same)
+            return S->ThrowError(this, "conflicting types for `" + Name + "`");
+        if (Previous->BodyExpr && BodyExpr)
+            return S->ThrowError(this, "redefinition of `" + Name + "`");
+        // The first declaration decides the linkage, `inline` on any of them counts
+        if (IsStatic && !Previous->IsStatic)
+            return S->ThrowError(this, "static declaration of `" + Name + "` follows non-static declaration");
+        IsStatic = Previous->IsStatic;
+        IsInline |= Previous->IsInline;
+    }
+    // Later calls see the definition rather than an earlier declaration
+    if (Result == S->Functions.end() || BodyExpr)
+        S->Functions[Name] = this;
+
+    if (!BodyExpr)
+        return Type;
+
+    S->PushScope();
+    S->ReturnType = Type;
+    S->ReturnDecl = ReturnAllocNode;
+    for (auto Param: Params)
+        if (!S->TryPutVar(Param, Param->Type))
+            return S->ThrowError(Param, "redefinition of parameter `" + Param->Name + "`");
+    BodyExpr->Check(S);
+    S->ReturnType = nullptr;
+    S->ReturnDecl = nullptr;
+    S->PopScope();
+    return Type;
+}
+
+CType *ReturnNode::Check(Sema *S) {
+    if (!S->ReturnType)
+        return S->ThrowError(this, "return statement outside of a function");
+
+    Type = S->ReturnType;
+    if (!Expr) {
+        if (!Type->IsVoid())
+            return S->ThrowError(this, "non-void function should return a value");
+        return Type;
+    }
+
+    auto ExprType = Expr->Check(S);
+    if (Type->IsVoid())
+        return S->ThrowError(this, "void function should not return a value");
+    S->CheckAssignable(this, ExprType, Type);
+    if (Type->IsPointer() && !S->ReturnDecl->IsPointeeConst() && S->PointsToConst(Expr))
+        return S->ThrowError(Expr, "return discards const qualifier");
+    return Type;
+}
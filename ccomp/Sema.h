@@ -0,0 +1,154 @@
+#ifndef SEMA_H
+#define SEMA_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Parser.h"
+#include "SymbolTable.h"
+
+// A C type. Types are interned by TypeContext, so two types are the same
+// exactly when they are the same object.
+class CType {
+public:
+    enum Kind {
+        VOID,
+        INT,
+        FLOAT,
+        POINTER,
+        ARRAY,
+        STRUCT,
+    };
+
+    Kind TypeKind;
+    // Size in bytes of an integer or floating point type
+    size_t Size;
+    bool IsSigned;
+    // Pointee of a pointer, element of an array
+    CType *Base;
+    // Element count of an array, zero for a variable length one
+    uint64_t Count;
+    bool IsVLA;
+    // Struct name and fields
+    std::string Name;
+    std::vector<std::string> FieldNames;
+    std::vector<CType *> FieldTypes;
+
+    bool IsVoid() const;
+
+    bool IsInteger() const;
+
+    bool IsFloat() const;
+
+    bool IsArithmetic() const;
+
+    bool IsPointer() const;
+
+    bool IsArray() const;
+
+    bool IsStruct() const;
+
+    bool IsScalar() const;
+
+    std::string ToString() const;
+
+private:
+    friend class TypeContext;
+
+    CType *PointerTo;
+
+    CType *VLAOf;
+};
+
+class TypeContext {
+public:
+    TypeContext();
+
+    CType *Void;
+    CType *Char;
+    CType *Short;
+    CType *Int;
+    CType *Long;
+    CType *Float;
+    CType *Double;
+
+    CType *GetPointer(CType *Pointee);
+
+    CType *GetArray(CType *Element, uint64_t Count);
+
+    CType *GetVLA(CType *Element);
+
+    // Structs are nominal, every definition is a new type
+    CType *CreateStruct(const std::string &Name);
+
+private:
+    std::vector<std::unique_ptr<CType>> Types;
+    std::map<std::pair<CType *, uint64_t>, CType *> Arrays;
+
+    CType *Create(CType::Kind Kind, size_t Size = 0, CType *Base = nullptr);
+};
+
+// Type checks a parsed translation unit before anything is generated for it.
+// Every node gets the type of the value it produces: expressions in value
+// contexts get decayed types, declarations the declared one, statements void.
+class Sema {
+public:
+    Sema();
+
+    TypeContext Types;
+
+    SymbolTable<CType *> Variables;
+    // Declaration of each visible variable, its qualifiers are not part of the type
+    SymbolTable<AllocNode *> Declarations;
+
+    std::map<std::string, CType *> TypeNames;
+    std::map<std::string, PrototypeNode *> Functions;
+
+    // Return type of the function being checked
+    CType *ReturnType;
+    // Its declaration, which carries the qualifiers
+    AllocNode *ReturnDecl;
+
+    CType *ThrowError(PNode *RelatedNode, std::string Text);
+
+    void Check(PNode *Node);
+
+    void PushScope();
+
+    void PopScope();
+
+    bool TryPutVar(AllocNode *Alloc, CType *Type);
+
+    bool TryGetVar(llvm::StringRef Name, CType **TypePtr);
+
+    AllocNode *GetDeclaration(llvm::StringRef Name);
+
+    bool TryPutType(const std::string &Name, CType *Type);
+
+    bool TryGetType(const std::string &Name, CType **TypePtr);
+
+    // Named type plus the pointer levels of a declaration
+    CType *GetAllocType(AllocNode *Alloc);
+
+    // Arrays decay to a pointer to their first element in value contexts
+    CType *Decay(CType *Type);
+
+    // Integer promotion: everything narrower than int is computed as int
+    CType *Promote(CType *Type);
+
+    CType *GetCommonType(CType *L, CType *R);
+
+    // Checks an operand the parser may have left out
+    CType *CheckOperand(PNode *Parent, PNode *Operand);
+
+    // Checks that a value of type From may be stored into To
+    void CheckAssignable(PNode *RelatedNode, CType *From, CType *To);
+
+    // Whether the pointer Expr evaluates to points to const, as far as the
+    // declarations it names tell
+    bool PointsToConst(PNode *Expr);
+};
+
+#endif
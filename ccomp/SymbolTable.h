@@ -0,0 +1,70 @@
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include <vector>
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+
+// Block-scoped name bindings in a single hash table. Each name is interned once
+// and its entry holds the innermost binding; declaring over an outer binding
+// saves it on an undo stack, and leaving a scope restores everything declared
+// since the scope was entered. Lookups are one probe at any nesting depth and,
+// once the stacks have grown to the deepest nesting, scopes allocate nothing.
+template<typename T>
+class SymbolTable {
+public:
+    void PushScope() {
+        ScopeMarks.push_back(UndoStack.size());
+    }
+
+    void PopScope() {
+        auto Mark = ScopeMarks.back();
+        ScopeMarks.pop_back();
+        while (UndoStack.size() > Mark) {
+            auto &Undo = UndoStack.back();
+            Undo.Entry->second = Undo.Shadowed;
+            UndoStack.pop_back();
+        }
+    }
+
+    // Fails if Name is already declared in the innermost scope
+    bool TryPut(llvm::StringRef Name, T Value) {
+        auto &Entry = *Names.try_emplace(Name).first;
+        auto Depth = (unsigned) ScopeMarks.size();
+        if (Entry.second.Depth == Depth)
+            return false;
+
+        UndoStack.push_back({&Entry, Entry.second});
+        Entry.second = {Value, Depth};
+        return true;
+    }
+
+    bool TryGet(llvm::StringRef Name, T *ValuePtr) const {
+        auto Result = Names.find(Name);
+        if (Result == Names.end() || !Result->second.Depth)
+            return false;
+        *ValuePtr = Result->second.Value;
+        return true;
+    }
+
+private:
+    class Binding {
+    public:
+        T Value{};
+        // Scope depth of the declaration, zero when the name is unbound
+        unsigned Depth = 0;
+    };
+
+    class Undo {
+    public:
+        llvm::StringMapEntry<Binding> *Entry;
+        Binding Shadowed;
+    };
+
+    llvm::StringMap<Binding> Names;
+    std::vector<Undo> UndoStack;
+    std::vector<size_t> ScopeMarks;
+};
+
+#endif
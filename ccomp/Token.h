@@ -10,21 +10,21 @@
 
 enum class TType {
     END_OF_FILE,
-    L_PAREN, R_PAREN, L_BRACE, R_BRACE, L_SCR, R_SCR, COMMA, DOT, VARARG,
+    L_PAREN, R_PAREN, L_BRACE, R_BRACE, L_SCR, R_SCR, COMMA, DOT, VARARG, HASH,
     PLUS, MINUS, STAR, SLASH, D_SLASH, PERCENT,
     BANG, BANG_EQ, EQUAL, D_EQUAL, LESS, LESS_EQ, GREAT, GREAT_EQ, OR, AND, BIN_OR, BIN_AND,
     SEMICOLON,
-    RETURN, IF, ELSE, FOR, WHILE, STRUCT, TYPEDEF,
+    RETURN, IF, ELSE, FOR, WHILE, STRUCT, TYPEDEF, STATIC, INLINE, RESTRICT, CONST,
     IDENTIFIER, STRING, INTEGER, FLOAT, CHAR,
 };
 
 static std::string TokenNames[]{
         "eof",
-        "(", ")", "{", "}", "[", "]", ",", ".", "...",
+        "(", ")", "{", "}", "[", "]", ",", ".", "...", "#",
         "+", "-", "*", "/", "//", "%",
         "!", "!=", "=", "==", "<", "<=", ">", ">=", "||", "&&", "|", "&",
         ";",
-        "return", "if", "else", "for", "while", "struct", "typedef",
+        "return", "if", "else", "for", "while", "struct", "typedef", "static", "inline", "restrict", "const",
         "id", "str", "int", "float", "char"
 };
 
@@ -0,0 +1,34 @@
+# Runs one sample program in the interpreter and as generated IR under lli,
+# and checks that both exit with EXPECTED_EXIT and print the same output.
+#
+#   cmake -DCCOMP=<ccomp> -DLLI=<lli> -DLLI_ARGS=<args> -DSOURCE=<file.c>
+#         -DEXPECTED_EXIT=<n> -DWORK_DIR=<dir> [-DCCOMP_ARGS=<args>] -P RunSample.cmake
+
+get_filename_component(Name "${SOURCE}" NAME_WE)
+file(MAKE_DIRECTORY "${WORK_DIR}")
+
+execute_process(COMMAND "${CCOMP}" -interpret "${SOURCE}"
+                RESULT_VARIABLE InterpExit OUTPUT_VARIABLE InterpOutput ERROR_VARIABLE InterpError)
+if (NOT InterpExit EQUAL EXPECTED_EXIT)
+  message(FATAL_ERROR "interpreter exited with ${InterpExit}, expected ${EXPECTED_EXIT}\n${InterpError}")
+endif ()
+
+if (NOT LLI)
+  return()
+endif ()
+
+set(IRPath "${WORK_DIR}/${Name}.ll")
+execute_process(COMMAND "${CCOMP}" ${CCOMP_ARGS} -emit-llvm -o "${IRPath}" "${SOURCE}"
+                RESULT_VARIABLE GenExit OUTPUT_VARIABLE GenOutput ERROR_VARIABLE GenError)
+if (NOT GenExit EQUAL 0)
+  message(FATAL_ERROR "ccomp ${CCOMP_ARGS} -emit-llvm failed\n${GenOutput}${GenError}")
+endif ()
+
+execute_process(COMMAND "${LLI}" ${LLI_ARGS} "${IRPath}"
+                RESULT_VARIABLE LLIExit OUTPUT_VARIABLE LLIOutput ERROR_VARIABLE LLIError)
+if (NOT LLIExit EQUAL EXPECTED_EXIT)
+  message(FATAL_ERROR "lli exited with ${LLIExit}, expected ${EXPECTED_EXIT}\n${LLIError}")
+endif ()
+if (NOT LLIOutput STREQUAL InterpOutput)
+  message(FATAL_ERROR "output differs\ninterpreter: ${InterpOutput}\nlli: ${LLIOutput}")
+endif ()
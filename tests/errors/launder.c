@@ -0,0 +1,3 @@
+int *launder(const int *p) {
+    return p;
+}
@@ -0,0 +1,2 @@
+int helper(int v);
+int main() { return helper(20) - 40; }
@@ -0,0 +1,2 @@
+int helper(int v) { return v * 2; }
+int dead(int v) { return v + 7; }
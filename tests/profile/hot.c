@@ -0,0 +1,8 @@
+int rare(int v) { return v * 3 + 1; }
+int hot(int v) { return v + 1; }
+int main() {
+    int s = 0;
+    for (int i = 0; i < 1000; i = i + 1) { s = hot(s); }
+    if (s < 0) { s = rare(s); }
+    return s - 1000;
+}
@@ -0,0 +1,28 @@
+int printf(char *fmt, ...);
+int counter = 5;
+int table[4];
+char *greeting = "hi";
+int sum(int *p, int n) {
+    int s = 0;
+    for (int i = 0; i < n; i = i + 1) { s = s + p[i]; }
+    return s;
+}
+int vla(int n) {
+    int total = 0;
+    for (int k = 0; k < 3; k = k + 1) {
+        int buf[n];
+        for (int i = 0; i < n; i = i + 1) { buf[i] = i * k; }
+        total = total + sum(buf, n);
+    }
+    return total;
+}
+int main() {
+    int a[10];
+    for (int i = 0; i < 10; i = i + 1) { a[i] = i * i; }
+    int *p = a;
+    p[2] = 100;
+    for (int i = 0; i < 4; i = i + 1) { table[i] = i + counter; }
+    counter = counter + 1;
+    printf("%d %d %d %d %d %s\n", sum(a, 10), p[3], vla(5), sum(table, 4), counter, greeting);
+    return sum(a, 10) + counter;
+}
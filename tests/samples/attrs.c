@@ -0,0 +1,15 @@
+int printf(char *fmt, ...);
+int table[4];
+int square(int v) { return v * v; }
+int first(int *values) { return values[0] + table[1]; }
+void fill(int *values, int n) {
+    for (int i = 0; i < n; i = i + 1) { values[i] = square(i); }
+}
+int main() {
+    int a[4];
+    fill(a, 4);
+    fill(table, 4);
+    int r = first(a + 2) + square(3);
+    printf("%d\n", r);
+    return r;
+}
@@ -0,0 +1,20 @@
+int printf(const char *fmt, ...);
+const int squares[8] = {0, 1, 4, 9, 16, 25, 36, 49};
+const double weights[4] = {0.5, 0.25};
+const int limit = 6;
+int counter = 3;
+int sum(const int *values, int n) {
+    int total = 0;
+    for (int i = 0; i < n; i = i + 1) { total = total + values[i]; }
+    return total;
+}
+int main() {
+    const int local[5] = {1, 2, 3};
+    int mixed[4] = {counter, counter + 1};
+    int *const p = mixed;
+    p[3] = 7;
+    int total = sum(squares, limit) + squares[7] + weights[1] * 8 + weights[3];
+    total = total + sum(local, 5) + mixed[0] + mixed[1] + mixed[2] + mixed[3] + squares[counter];
+    printf("%d\n", total);
+    return total;
+}
@@ -0,0 +1,45 @@
+int printf(char *fmt, ...);
+int fib(int n) {
+    if (n < 2) { return n; }
+    return fib(n - 1) + fib(n - 2);
+}
+int collatz(int n) {
+    int steps = 0;
+    for (int k = 0; n != 1; k = k + 1) {
+        int half = n / 2;
+        if (half * 2 == n) { n = half; } else { n = 3 * n + 1; }
+        steps = steps + 1;
+    }
+    return steps;
+}
+int nest(int m) {
+    int total = 0;
+    for (int i = 0; i < m; i = i + 1) {
+        for (int j = 0; j < i; j = j + 1) {
+            int t = i * j;
+            total = total + t;
+        }
+    }
+    return total;
+}
+void swap(int *a, int *b) {
+    int t = *a;
+    int u = *b;
+    *a = u;
+    *b = t;
+}
+int early(int x) {
+    for (int i = 0; i < 100; i = i + 1) {
+        if (i == x) { return i * 10; }
+    }
+    return 0 - 1;
+}
+int main() {
+    int x = 3;
+    int y = 4;
+    int p = 1;
+    swap(&x, &y);
+    if (x) { p = 2; }
+    printf("%d %d %d %d %d %d %d %d\n", fib(15), collatz(27), nest(10), x, y, early(7), early(200), p);
+    return fib(15) + collatz(27) + x;
+}
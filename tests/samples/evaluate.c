@@ -0,0 +1,21 @@
+int printf(char *fmt, ...);
+int g;
+int sq(int x) { return x * x; }
+int fib(int n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }
+int tri(int n) { int s = 0; for (int i = 0; i < n; i = i + 1) { s = s + i; } return s; }
+int spin(int n) { for (;;) { n = n + 1; if (n == 100000) { return n; } } return n; }
+int deep(int n) { if (n == 1000) { return n; } return deep(n + 1); }
+int quot(int a, int b) { return a / b; }
+int useg(int x) { return x + g; }
+int shadow(int x) { { int g = 3; x = x + g; } return x; }
+int tsq = sq(12);
+int tfib = fib(20);
+int main() {
+    g = 5;
+    int a = sq(7);
+    int b = tri(100);
+    int c = spin(1);
+    int d = deep(1);
+    printf("%d %d %d %d %d %d %d %d %d %d\n", tsq, tfib, a, b, c, d, quot(7, 2), useg(1), shadow(1), sq(a));
+    return tfib + a + b + d;
+}
@@ -0,0 +1,33 @@
+int printf(char *fmt, ...);
+int errors = 0;
+int check(int v) {
+    if (__builtin_expect(v < 0, 0)) {
+        errors = errors + 1;
+        return 0;
+    }
+    return v;
+}
+int clamp(int v, int hi) {
+    if (v > hi) [[unlikely]] {
+        return hi;
+    } else [[likely]] {
+        return v;
+    }
+}
+int scan(int *a, int n) {
+    int s = 0;
+    for (int i = 0; __builtin_expect(i < n, 1); i = i + 1) {
+        if (!__builtin_expect(a[i] != 0, 1)) { return s; }
+        s = s + a[i];
+    }
+    return s;
+}
+int main() {
+    int a[5];
+    for (int i = 0; i < 5; i = i + 1) { a[i] = 4 - i; }
+    long e = __builtin_expect(a[1] * 2, 6);
+    int r = check(5) + check(0 - 3) + clamp(9, 7) + clamp(2, 7) + scan(a, 5);
+    if (__builtin_expect(r, 0) && r > 1) [[likely]] { r = r + 100; }
+    printf("%d %d %ld\n", r, errors, e);
+    return r + errors + e;
+}
@@ -0,0 +1,31 @@
+int printf(char *fmt, ...);
+double sum(double *v, int n) {
+    double s = 0.0;
+    for (int i = 0; i < n; i = i + 1) {
+        s = s + v[i];
+    }
+    return s;
+}
+float scale(float x, int k) {
+    return x * k;
+}
+int sign(double x) {
+    if (x < 0.0) { return 0 - 1; }
+    if (x > 0.0) { return 1; }
+    return 0;
+}
+int main() {
+    double v[8];
+    for (int i = 0; i < 8; i = i + 1) { v[i] = i * 0.5; }
+    double s = sum(v, 8);
+    float f = scale(1.25, 6);
+    int t = s;
+    long q = f * 4.0;
+    double n = -s;
+    int c = sign(n) + sign(0.0) * 10 + sign(f) * 100;
+    int z = !n + !0.0 * 2;
+    double h = 7 / 2.0;
+    int e = h == 3.5 && f != 7.0 && s >= 14.0 && s <= 14.0;
+    printf("%f %f %d %ld %f %d %d %d\n", s, f, t, q, h, c, z, e);
+    return t + q + c + z * 5 + e * 7;
+}
@@ -0,0 +1,24 @@
+int printf(char *fmt, ...);
+int g = 2 * 8 + 1;
+int side(int x) { printf("side "); return x; }
+int f(int x) {
+    int k = 4;
+    int m = k * 3 - 2;
+    int y = x * 1 + 0;
+    int z = side(y) * 0;
+    int w = y * 0;
+    char c = 300;
+    int q = c + 1;
+    if (k > 3) { y = y + m; } else { y = y - 1000; }
+    if (0) { printf("dead\n"); }
+    if (1 == 2) { y = 0; } else { y = y + 1; }
+    int a = 7;
+    int *p = &a;
+    *p + 1;
+    int d = 10 / 0 * 0;
+    return y + z + w + q + a + !k + -k;
+}
+int main() {
+    printf("%d %d\n", f(5), g);
+    return f(5) + g;
+}
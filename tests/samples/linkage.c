@@ -0,0 +1,16 @@
+int printf(char *fmt, ...);
+static int twice(int v);
+static int unused(int v) { return v + 1; }
+inline int square(int v) { return v * v; }
+static inline int cube(int v) { return square(v) * v; }
+int sum(int n) {
+    int s = 0;
+    for (int i = 0; i < n; i = i + 1) { s = s + twice(i); }
+    return s;
+}
+static int twice(int v) { return v * 2; }
+int main() {
+    int r = sum(5) + square(3) + cube(2);
+    printf("%d\n", r);
+    return r;
+}
@@ -0,0 +1,39 @@
+int printf(char *fmt, ...);
+int calls = 0;
+int touch(int v) {
+    calls = calls + 1;
+    return v;
+}
+int inrange(int x, int lo, int hi) {
+    if (x >= lo && x < hi) { return 1; }
+    return 0;
+}
+int count(int *a, int n, int limit) {
+    int i = 0;
+    for (; i < n && a[i] < limit; i = i + 1) {
+    }
+    return i;
+}
+int pick(int a, int b, int c) {
+    return a && b || c;
+}
+int flag(int a, int b) {
+    int c = a < b;
+    if (c) { a = a + 20; }
+    return c + a;
+}
+int main() {
+    int a[6];
+    for (int i = 0; i < 6; i = i + 1) { a[i] = i * i; }
+    int r = 0;
+    if (touch(0) && touch(1)) { r = 100; }
+    if (touch(1) || touch(1)) { r = r + 1; }
+    if (!touch(0) && !touch(0)) { r = r + 2; }
+    int v = touch(1) && touch(0) || touch(3);
+    int w = touch(0) || touch(0);
+    int s = pick(1, 0, 0) + pick(0, 1, 1) * 2 + pick(1, 1, 0) * 4 + inrange(5, 0, 5) * 8 + inrange(4, 0, 5) * 16;
+    int c = count(a, 6, 10) + count(a, 6, 100) * 10;
+    int f = flag(9, 10);
+    printf("%d %d %d %d %d %d %d\n", r, v, w, s, c, calls, f);
+    return r + v * 2 + w * 4 + s + c + calls + f;
+}
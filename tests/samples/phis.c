@@ -0,0 +1,17 @@
+int printf(char *fmt, ...);
+int main() {
+    int u = 0;
+    int total = 0;
+    for (int i = 0; i < 5; i = i + 1) {
+        total = total + u;
+        for (int j = 3; j > 0 && u < 1000 || j == 7; j = j - 1) {
+            if (j == 2) {
+                u = u + 3;
+                j = j - 1;
+            }
+            u = u + 1;
+        }
+    }
+    printf("%d %d\n", total, u);
+    return total + u;
+}
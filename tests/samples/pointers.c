@@ -0,0 +1,24 @@
+int printf(char *fmt, ...);
+struct P { int x; int y; };
+typedef struct P Pt;
+typedef int *IntPtr;
+int get(IntPtr q) { return *q; }
+long diff(int *a, int *b) { return a - b; }
+int main() {
+    int a[5];
+    for (int i = 0; i < 5; i = i + 1) { a[i] = i * 3; }
+    int *p = a + 1;
+    int *e = &a[4];
+    int **pp = &p;
+    char c = 'A';
+    int sum = c + 1;
+    long big = sum;
+    big = big * 1000000;
+    Pt s;
+    Pt *ps = &s;
+    int neg = -a[2];
+    int n = !0 + !a[1];
+    printf("%d %d %ld %d %d %ld %d %d\n", get(p), **pp, diff(e, p), sum, c, big, neg, n);
+    if (p < e) { printf("lt\n"); }
+    return get(p) + sum + neg;
+}
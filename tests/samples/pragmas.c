@@ -0,0 +1,39 @@
+int printf(char *fmt, ...);
+int dot(int *a, int *b, int n) {
+    int s = 0;
+#pragma unroll(4)
+    for (int i = 0; i < n; i = i + 1) {
+        s = s + a[i] * b[i];
+    }
+    return s;
+}
+void scale(int *out, int *in, int n, int k) {
+#pragma vectorize width(4)
+#pragma unroll(1)
+    for (int i = 0; i < n; i = i + 1) {
+        out[i] = in[i] * k;
+    }
+}
+int split(int *a, int *b, int *c, int n) {
+#pragma distribute
+#pragma vectorize(enable)
+    for (int i = 0; i < n; i = i + 1) {
+        a[i] = b[i] + 1;
+        c[i] = c[i] + b[i];
+    }
+    return a[n - 1] + c[n - 1];
+}
+int main() {
+    int a[16];
+    int b[16];
+    int c[16];
+    for (int i = 0; i < 16; i = i + 1) { a[i] = i; b[i] = 16 - i; c[i] = 1; }
+    int d = dot(a, b, 16);
+    scale(c, a, 16, 3);
+    int t = 0;
+#pragma unroll
+    for (int j = 0; j < 4; j = j + 1) { t = t + c[j * 5]; }
+    int e = split(a, b, c, 16);
+    printf("%d %d %d\n", d, t, e);
+    return d % 256 + t + e;
+}
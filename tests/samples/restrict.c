@@ -0,0 +1,12 @@
+int printf(char *fmt, ...);
+void axpy(float *restrict out, float *restrict in, int n) {
+    for (int i = 0; i < n; i = i + 1) { out[i] = out[i] + in[i] * 2.0; }
+}
+int main() {
+    float a[8];
+    float b[8];
+    for (int i = 0; i < 8; i = i + 1) { a[i] = i; b[i] = 1; }
+    axpy(a, b, 8);
+    printf("%f\n", a[7]);
+    return a[7];
+}
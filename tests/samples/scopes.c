@@ -0,0 +1,10 @@
+int printf(char *fmt, ...);
+int x = 1;
+int main() {
+    int x = 2;
+    { int x = 3; printf("%d ", x); }
+    printf("%d ", x);
+    for (int x = 9; x < 10; x = x + 1) { printf("%d ", x); }
+    { int y = x; printf("%d\n", y); }
+    return x;
+}